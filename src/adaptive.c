@@ -0,0 +1,402 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Adaptive trajectory integration.
+ *
+ * The flight is integrated with the Dormand-Prince 5(4) embedded Runge-Kutta
+ * pair, using the local error estimate to size each step. Rows are not tied
+ * to step boundaries: the continuous extension of each accepted step is
+ * solved for the instant the projectile reaches each whole yard, so every
+ * row sits exactly on its range. The state vector is x, y (feet) and
+ * vx, vy (fps); time is in seconds. */
+
+#include <string.h>
+#include "internal.h"
+
+#define STATE_SIZE 4
+
+/* With sensitivities, their tangents follow the state in the same vector.
+ * Only the state takes part in error control, so the steps are the same
+ * either way. */
+#define MAX_SIZE    (STATE_SIZE + TANGENT_SIZE)
+
+/* Used when the context does not specify a tolerance */
+#define DEFAULT_TOLERANCE   1e-8
+
+/* Step size bounds (seconds) */
+#define INITIAL_STEP        1e-3
+#define MINIMUM_STEP        1e-12
+
+/* Dormand-Prince coefficients. The system is autonomous, so the stage
+ * times are not needed. */
+static const double a21 = 1.0/5;
+static const double a31 = 3.0/40, a32 = 9.0/40;
+static const double a41 = 44.0/45, a42 = -56.0/15, a43 = 32.0/9;
+static const double a51 = 19372.0/6561, a52 = -25360.0/2187,
+    a53 = 64448.0/6561, a54 = -212.0/729;
+static const double a61 = 9017.0/3168, a62 = -355.0/33,
+    a63 = 46732.0/5247, a64 = 49.0/176, a65 = -5103.0/18656;
+static const double a71 = 35.0/384, a73 = 500.0/1113, a74 = 125.0/192,
+    a75 = -2187.0/6784, a76 = 11.0/84;
+
+/* Difference between the fifth and fourth order solutions */
+static const double e1 = 71.0/57600, e3 = -71.0/16695, e4 = 71.0/1920,
+    e5 = -17253.0/339200, e6 = 22.0/525, e7 = -1.0/40;
+
+/* Continuous extension */
+static const double d1 = -12715105075.0/11282082432,
+    d3 = 87487479700.0/32700410799, d4 = -10690763975.0/1880347072,
+    d5 = 701980252875.0/199316789632, d6 = -1453857185.0/822651844,
+    d7 = 69997945.0/29380423;
+
+struct flight {
+    struct schedule_cursor schedule;
+    struct solve_stats stats;
+    struct tangent_model tangent;
+    ballistics_sensitivity_t sensitivity;
+    ballistics_events_t events;
+    double Gx, Gy;
+    double dv;
+};
+
+/* An accepted step's continuous extension, for event location */
+
+struct step_extension {
+    const double *r;
+    int size;
+    double t, h;
+};
+
+/* Derivative of the state. Returns -1 where the solver would stop: no usable
+ * ballistic coefficient or a stalled projectile. */
+
+static int derivative(struct flight *f, const double *s, double *ds) {
+    double vx = s[2], vy = s[3];
+    double v = sqrt(vx*vx + vy*vy);
+    double bC, dv;
+
+    if (!(v > 0.0))
+        return -1;
+
+    if (f->schedule.air)
+        libballistics_scheduleAltitude(&f->schedule, s[0], s[1]);
+    dv = libballistics_scheduleRetardation(&f->schedule, v, &bC);
+    if (bC == 0.0)
+        return -1;
+    LIBBALLISTICS_STAT(f->stats.retardations++);
+    f->dv = dv;
+    ds[0] = vx;
+    ds[1] = vy;
+    ds[2] = -(vx/v) * dv + f->Gx;
+    ds[3] = -(vy/v) * dv + f->Gy;
+    if (f->sensitivity)
+        libballistics_tangentDerivative(&f->tangent, s, dv, s + STATE_SIZE,
+            ds + STATE_SIZE);
+    return 0;
+}
+
+/* Continuous extension of an accepted step, for 0 <= theta <= 1. The
+ * coefficients of each of the 'size' components are 'size' apart. */
+
+static double dense(const double *r, int size, int i, double theta) {
+    double theta1 = 1.0 - theta;
+    return r[i] + theta * (r[size + i] + theta1 * (r[2*size + i]
+        + theta * (r[3*size + i] + theta1 * r[4*size + i])));
+}
+
+/* Fraction of the step at which x reaches 'range' feet. x rises
+ * monotonically with slope h * vx, so Newton's method from the linear
+ * estimate converges in two or three iterations. */
+
+static double solveRange(const double *r, int size, double x0, double x1,
+    double h, double range)
+{
+    double theta = (range - x0) / (x1 - x0);
+    double delta;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        delta = (dense(r, size, 0, theta) - range)
+            / (h * dense(r, size, 2, theta));
+        theta -= delta;
+        if (theta < 0.0)
+            theta = 0.0;
+        if (theta > 1.0)
+            theta = 1.0;
+        if (fabs(delta) < 1e-14)
+            break;
+    }
+    return theta;
+}
+
+static void extensionState(const void *arg, double theta,
+    struct event_state *state)
+{
+    const struct step_extension *e = arg;
+
+    state->x = dense(e->r, e->size, 0, theta);
+    state->y = dense(e->r, e->size, 1, theta);
+    state->vx = dense(e->r, e->size, 2, theta);
+    state->vy = dense(e->r, e->size, 3, theta);
+    state->t = e->t + theta * e->h;
+}
+
+/* Passes an accepted step from s to s1 to the event detection */
+
+static void stepEvents(const struct flight *f, const double *r, int size,
+    const double *s, const double *s1, double t, double h)
+{
+    struct step_extension extension;
+    struct event_state from, to;
+
+    extension.r = r;
+    extension.size = size;
+    extension.t = t;
+    extension.h = h;
+    from.x = s[0], from.y = s[1], from.vx = s[2], from.vy = s[3];
+    from.t = t;
+    to.x = s1[0], to.y = s1[1], to.vx = s1[2], to.vy = s1[3];
+    to.t = t + h;
+    libballistics_eventsStep(f->events, &from, &to, extensionState,
+        &extension);
+}
+
+/* Stores row n, or passes it to the sampled output. Returns nonzero when
+ * the output asks to stop. */
+
+static int record(ballistics_ctx_t context, const struct flight *f,
+    unsigned long n, double velocity, double crosswind, const double *s,
+    double t)
+{
+    trajectory_path_t traj;
+    double x = s[0], y = s[1];
+
+    if (f->sensitivity)
+        libballistics_tangentRecord(&f->tangent, f->sensitivity + n, x, t,
+            s[2], s[3], s + STATE_SIZE);
+
+    if (context->output)
+        return libballistics_outputState(context->output, n, x, y, t,
+            sqrt(s[2]*s[2] + s[3]*s[3]), s[2], s[3], crosswind, velocity);
+
+    traj = context->trajectory + n;
+    traj->range = x / 3;
+    traj->pathY = y * 12;
+    traj->pathX = libballistics_computeWindage(crosswind, velocity, x, t);
+    traj->elevation = libballistics_rad2moa(atan(y/x));
+    traj->windage = traj->pathX * 95.5 / (x / 3);
+    traj->time = t;
+    traj->velocity = sqrt(s[2]*s[2] + s[3]*s[3]);
+    traj->velocityX = s[2];
+    traj->velocityY = s[3];
+    return 0;
+}
+
+int libballistics_computeTrajectoryAdaptive(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double velocity,
+    double sightHeight,
+    double losAngle,
+    double zeroAngle,
+    double windVelocity,
+    double windAngle,
+    unsigned long maxRange)
+{
+    struct flight f;
+    double s[MAX_SIZE], s1[MAX_SIZE], w[MAX_SIZE];
+    double k1[MAX_SIZE], k2[MAX_SIZE], k3[MAX_SIZE], k4[MAX_SIZE];
+    double k5[MAX_SIZE], k6[MAX_SIZE], k7[MAX_SIZE];
+    double r[5*MAX_SIZE];
+    double tol = context->tolerance > 0.0 ? context->tolerance
+        : DEFAULT_TOLERANCE;
+    double crosswind = libballistics_crossWind(windVelocity, windAngle);
+    double headwind = libballistics_headWind(windVelocity, windAngle);
+    double t = 0, h = INITIAL_STEP, err, sc, e, factor, theta;
+    unsigned long n = 0, steps = 0;
+    int i, size, stop = 0;
+
+    libballistics_statsBegin(context, &f.stats);
+    f.Gy = LIBBALLISTICS_GRAVITY
+        * cos(libballistics_deg2rad((losAngle + zeroAngle)));
+    f.Gx = LIBBALLISTICS_GRAVITY
+        * sin(libballistics_deg2rad((losAngle + zeroAngle)));
+
+    maxRange++;
+    if (context->output) {
+        if (libballistics_outputBegin(context->output, maxRange))
+            return -1;
+    } else if (libballistics_reserveTrajectory(context, maxRange + 1)) {
+        return -1;
+    }
+    f.sensitivity = context->sensitivities;
+    if (f.sensitivity && context->sensitivityCapacity < maxRange)
+        return -1;
+    f.events = context->events;
+    if (f.events)
+        libballistics_eventsBegin(f.events);
+    if (libballistics_compileSchedule(context, dragFunction, headwind))
+        return -1;
+    libballistics_initSchedule(&f.schedule, context, dragFunction, headwind);
+    f.schedule.air = libballistics_atmosphereTable(context, losAngle,
+        maxRange);
+    context->maxRange = maxRange;
+    context->maxValidRange = 0;
+    context->muzzleVelocity = velocity;
+    context->headwind = headwind;
+    context->crosswind = crosswind;
+
+    s[0] = 0;
+    s[1] = -sightHeight/12;
+    s[2] = velocity * cos(libballistics_deg2rad(zeroAngle));
+    s[3] = velocity * sin(libballistics_deg2rad(zeroAngle));
+    size = STATE_SIZE;
+    if (f.sensitivity) {
+        libballistics_tangentStart(&f.tangent, context, &f.schedule,
+            velocity, zeroAngle, windVelocity, windAngle, f.Gx, f.Gy,
+            s + STATE_SIZE);
+        size = MAX_SIZE;
+    }
+    libballistics_statsPhase(context, &f.stats, PhaseSetup);
+
+    if (derivative(&f, s, k1) == 0) {
+        if (f.sensitivity)
+            libballistics_tangentCross(&f.tangent, s, f.dv, s + STATE_SIZE);
+        stop = record(context, &f, 0, velocity, crosswind, s, t);
+        n++;
+    }
+
+    while (n > 0 && n < maxRange && !stop) {
+        if (h < MINIMUM_STEP)
+            break;
+        steps++;
+
+        for (i = 0; i < size; i++)
+            w[i] = s[i] + h * a21*k1[i];
+        if (derivative(&f, w, k2))
+            break;
+        for (i = 0; i < size; i++)
+            w[i] = s[i] + h * (a31*k1[i] + a32*k2[i]);
+        if (derivative(&f, w, k3))
+            break;
+        for (i = 0; i < size; i++)
+            w[i] = s[i] + h * (a41*k1[i] + a42*k2[i] + a43*k3[i]);
+        if (derivative(&f, w, k4))
+            break;
+        for (i = 0; i < size; i++)
+            w[i] = s[i] + h * (a51*k1[i] + a52*k2[i] + a53*k3[i]
+                + a54*k4[i]);
+        if (derivative(&f, w, k5))
+            break;
+        for (i = 0; i < size; i++)
+            w[i] = s[i] + h * (a61*k1[i] + a62*k2[i] + a63*k3[i]
+                + a64*k4[i] + a65*k5[i]);
+        if (derivative(&f, w, k6))
+            break;
+        for (i = 0; i < size; i++)
+            s1[i] = s[i] + h * (a71*k1[i] + a73*k3[i] + a74*k4[i]
+                + a75*k5[i] + a76*k6[i]);
+        if (derivative(&f, s1, k7))
+            break;
+
+        /* RMS of the local error relative to the tolerance, which applies
+         * both absolutely and relative to each component's magnitude */
+        err = 0;
+        for (i = 0; i < STATE_SIZE; i++) {
+            sc = tol * (1.0 + (fabs(s[i]) > fabs(s1[i]) ? fabs(s[i])
+                : fabs(s1[i])));
+            e = h * (e1*k1[i] + e3*k3[i] + e4*k4[i] + e5*k5[i] + e6*k6[i]
+                + e7*k7[i]) / sc;
+            err += e * e;
+        }
+        err = sqrt(err / STATE_SIZE);
+
+        factor = err > 0.0 ? 0.9 * pow(err, -0.2) : 5.0;
+        if (factor > 5.0)
+            factor = 5.0;
+        if (factor < 0.2)
+            factor = 0.2;
+
+        if (err > 1.0) {
+            h *= factor < 1.0 ? factor : 1.0;
+            continue;
+        }
+
+        /* Accepted. Fill every row the step crossed from the continuous
+         * extension, and look for events on it. */
+        if (3.0 * n <= s1[0] || f.events) {
+            for (i = 0; i < size; i++) {
+                r[i] = s[i];
+                r[size + i] = s1[i] - s[i];
+                r[2*size + i] = h * k1[i] - r[size + i];
+                r[3*size + i] = r[size + i] - h * k7[i]
+                    - r[2*size + i];
+                r[4*size + i] = h * (d1*k1[i] + d3*k3[i] + d4*k4[i]
+                    + d5*k5[i] + d6*k6[i] + d7*k7[i]);
+            }
+            while (n < maxRange && 3.0 * n <= s1[0] && !stop) {
+                theta = solveRange(r, size, s[0], s1[0], h, 3.0 * n);
+                for (i = 0; i < size; i++)
+                    w[i] = dense(r, size, i, theta);
+                stop = record(context, &f, n, velocity, crosswind, w,
+                    t + theta * h);
+                n++;
+            }
+            if (f.events)
+                stepEvents(&f, r, size, s, s1, t, h);
+        }
+
+        t += h;
+        for (i = 0; i < size; i++) {
+            s[i] = s1[i];
+            k1[i] = k7[i];
+        }
+        h *= factor;
+
+        /* k7 was the last derivative taken, so the schedule is at s. A
+         * corrected tangent needs its derivative again. */
+        if (f.sensitivity && libballistics_tangentCross(&f.tangent, s, f.dv,
+            s + STATE_SIZE) && derivative(&f, s, k1))
+            break;
+
+        if (fabs(s[3]) > fabs(3*s[2]))
+            break;
+        if (s[0] <= 0.0)
+            break;
+        context->maxValidRange = (int) s[0]/3;
+    }
+    context->steps = steps;
+    LIBBALLISTICS_STAT(f.stats.steps = steps);
+    LIBBALLISTICS_STAT(f.stats.bcLookups = f.stats.retardations);
+    LIBBALLISTICS_STAT(f.stats.bandSwitches = f.schedule.switches);
+    libballistics_statsPhase(context, &f.stats, PhaseIntegrate);
+
+    if (f.sensitivity)
+        memset(f.sensitivity + n, 0,
+            sizeof(struct ballistics_sensitivity) * (maxRange - n));
+    if (!context->output) {
+        memset(context->trajectory + n, 0,
+            sizeof(struct trajectory_path) * (maxRange + 1 - n));
+        context->trajectory[maxRange].range = n;
+        libballistics_statsPhase(context, &f.stats, PhaseFinish);
+    }
+    libballistics_statsEnd(context, &f.stats);
+    return n;
+}
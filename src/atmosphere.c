@@ -17,7 +17,7 @@
 
 */
 
-#include "ballistics.h"
+#include "internal.h"
 
 /* Atmospheric calculations */
 
@@ -68,3 +68,113 @@ double libballistics_applyAtmosphere(
     double cbC = (FA * (1 + FT - FP) * FR );
     return bC * cbC;
 }
+
+/* Atmospheres along the flight.
+ *
+ * From the station, temperature falls at the standard lapse rate up to the
+ * tropopause and stays constant above it. Pressure follows from
+ * hydrostatic balance, so density goes as (T / T0)^(g / RL - 1) below the
+ * tropopause and falls exponentially above. Humidity is held at its
+ * station value. These take a pow() or exp() each, so a solve evaluates
+ * them once per row of a small table and interpolates along the flight. */
+
+#define ATMOSPHERE_LAPSE        0.0035662   /* Degrees per foot */
+#define ATMOSPHERE_TROPOPAUSE   36089.0     /* Feet above sea level */
+#define ATMOSPHERE_GAS          0.0187434   /* g / R of dry air, degrees
+                                             * per foot */
+
+/* Density and absolute temperature 'height' feet above the station,
+ * relative to those at the station */
+
+static void stationRatios(
+    double altitude,
+    double temperature,
+    double height,
+    double *density,
+    double *theta)
+{
+    double n = ATMOSPHERE_GAS / ATMOSPHERE_LAPSE - 1;
+    double t0 = temperature + LIBBALLISTICS_ABSOLUTE_ZERO;
+    double top = ATMOSPHERE_TROPOPAUSE - altitude;
+    double t;
+
+    if (top > 0 && height <= top) {
+        t = t0 - ATMOSPHERE_LAPSE * height;
+        *density = pow(t / t0, n);
+    } else if (top > 0) {
+        t = t0 - ATMOSPHERE_LAPSE * top;
+        *density = pow(t / t0, n) * exp(-ATMOSPHERE_GAS * (height - top) / t);
+    } else if (height >= top) {
+        t = t0;
+        *density = exp(-ATMOSPHERE_GAS * height / t0);
+    } else {
+        t = t0 - ATMOSPHERE_LAPSE * (height - top);
+        *density = exp(-ATMOSPHERE_GAS * top / t0) * pow(t / t0, n);
+    }
+    *theta = t / t0;
+}
+
+int libballistics_setAtmosphere(
+    ballistics_ctx_t context,
+    int atmosphere,
+    double altitude,
+    double barometricPressure,
+    double temperature,
+    double relativeHumidity)
+{
+    if (atmosphere != AtmosphereNone && atmosphere != AtmosphereStandard)
+        return -1;
+    if (atmosphere == AtmosphereStandard) {
+        if (!(barometricPressure > 0.0)
+            || !(temperature > -LIBBALLISTICS_ABSOLUTE_ZERO))
+            return -1;
+        if (context->air == NULL)
+            context->air = malloc(sizeof(struct atmosphere_table));
+        if (context->air == NULL)
+            return -1;
+    }
+    context->atmosphere = atmosphere;
+    context->altitude = altitude;
+    context->barometricPressure = barometricPressure;
+    context->temperature = temperature;
+    context->relativeHumidity = relativeHumidity;
+    return 0;
+}
+
+const struct atmosphere_table *libballistics_atmosphereTable(
+    ballistics_ctx_t context,
+    double losAngle,
+    unsigned long maxRange)
+{
+    struct atmosphere_table *air = context->air;
+    double station, sound, span, height, density, theta, a;
+    int i;
+
+    if (context->atmosphere != AtmosphereStandard || air == NULL)
+        return NULL;
+
+    /* At the station, the density libballistics_applyAtmosphere corrects
+     * coefficients for and the speed of sound at its temperature */
+    station = 1.0 / libballistics_applyAtmosphere(1.0, context->altitude,
+        context->barometricPressure, context->temperature,
+        context->relativeHumidity);
+    sound = sqrt((context->temperature + LIBBALLISTICS_ABSOLUTE_ZERO)
+        / (59.0 + LIBBALLISTICS_ABSOLUTE_ZERO));
+
+    /* The flight cannot climb or fall further than its length; heights
+     * beyond the table take its end rows */
+    span = 3.0 * (maxRange + 1);
+    air->sinLos = sin(libballistics_deg2rad(losAngle));
+    air->cosLos = cos(libballistics_deg2rad(losAngle));
+    air->base = -span;
+    air->scale = (ATMOSPHERE_ROWS - 1) / (2 * span);
+    for (i = 0; i < ATMOSPHERE_ROWS; i++) {
+        height = air->base + i / air->scale;
+        stationRatios(context->altitude, context->temperature, height,
+            &density, &theta);
+        a = sound * sqrt(theta);
+        air->rows[i][0] = station * density * a * a;
+        air->rows[i][1] = 1.0 / a;
+    }
+    return air;
+}
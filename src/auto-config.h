@@ -51,6 +51,9 @@
 /* Define to 1 if you have the <unistd.h> header file. */
 #define HAVE_UNISTD_H 1
 
+/* Defined if solver statistics are enabled */
+/* #undef LIBBALLISTICS_STATS */
+
 /* Name of package */
 #define PACKAGE "libballistics"
 
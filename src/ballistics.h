@@ -42,6 +42,95 @@ enum BallisticDragFunction {
     G8
 };
 
+/* Columns of a trajectory table, in trajectory_path order */
+enum BallisticColumn {
+    ColumnRange=0,
+    ColumnPathY,
+    ColumnPathX,
+    ColumnElevation,
+    ColumnWindage,
+    ColumnTime,
+    ColumnVelocity,
+    ColumnVelocityX,
+    ColumnVelocityY,
+    ColumnCount
+};
+
+#define LIBBALLISTICS_COLUMN(c)     (1u << (c))
+#define LIBBALLISTICS_ALL_COLUMNS   ((1u << ColumnCount) - 1)
+
+enum BallisticPrecision {
+    OutputDouble=0,
+    OutputFloat
+};
+
+enum BallisticIntegrator {
+    EulerIntegrator=0,  /* Fixed steps of 0.5/v seconds (default) */
+    AdaptiveIntegrator  /* Dormand-Prince 5(4) with error control */
+};
+
+/* Air along the flight, set by libballistics_setAtmosphere */
+enum BallisticAtmosphere {
+    AtmosphereNone=0,   /* Standard conditions throughout (default) */
+    AtmosphereStandard  /* Station conditions, varied with height */
+};
+
+/* Statistics gathered by libballistics_setStats */
+enum BallisticStats {
+    StatsCounters=1,    /* Steps, drag evaluations, BC lookups, ... */
+    StatsTiming=2,      /* Wall clock time per solver phase */
+    StatsHardware=4     /* CPU cycles, instructions and branch misses */
+};
+
+enum BallisticPhase {
+    PhaseSetup=0,       /* Argument handling and buffer reservation */
+    PhaseIntegrate,     /* The integration loop, including row output */
+    PhaseFinish,        /* Clearing the unreached rows */
+    PhaseZero,          /* libballistics_solveContextZero */
+    PhaseCount
+};
+
+/* Interpolation used by a solution grid */
+enum BallisticInterpolation {
+    InterpolateLinear=0,    /* Multilinear in BC, velocity and range */
+    InterpolateCubic        /* Four point Lagrange cubic on each axis */
+};
+
+/* Parameters whose sensitivities libballistics_setSensitivities tracks */
+enum BallisticParameter {
+    ParameterVelocity=0,    /* Muzzle velocity (per fps) */
+    ParameterBC,            /* Ballistic coefficient (per unit) */
+    ParameterZeroAngle,     /* Zero angle (per degree) */
+    ParameterLosAngle,      /* Line of sight angle (per degree) */
+    ParameterWind,          /* Wind velocity at the wind angle (per MPH) */
+    ParameterCount
+};
+
+/* Events libballistics_setEvents detects during a solve */
+enum BallisticEvent {
+    EventMach12=0,          /* Velocity falls through Mach 1.2 */
+    EventMach10,            /* ... through Mach 1.0: subsonic */
+    EventMach08,            /* ... through Mach 0.8 */
+    EventApex,              /* Highest point above the line of sight */
+    EventZeroRising,        /* Path rises through the line of sight */
+    EventZeroFalling,       /* Path falls through the line of sight */
+    EventCount
+};
+
+#define LIBBALLISTICS_EVENT(e)      (1u << (e))
+
+/* Instruction sets the vectorized kernels are built for, lowest first */
+enum BallisticSimd {
+    SimdGeneric=0,          /* Portable C */
+    SimdSSE2,
+    SimdAVX2,               /* AVX2 with FMA */
+    SimdAVX512,             /* AVX-512F */
+    SimdCount
+};
+
+/* Standard speed of sound (fps) */
+#define LIBBALLISTICS_SPEED_OF_SOUND    1116.45
+
 /* Angular Conversion Functions */
 double libballistics_deg2moa(double deg); /* Degrees to MOA */
 double libballistics_deg2rad(double deg); /* Degrees to Radians */
@@ -54,7 +143,7 @@ double libballistics_moa2mil(double moa, int spec);
 /* libballistics_computeRetardation: calculates retardation values based on 
  *     standard drag functions 
  * Arguments:
- *     dragFunction: G1, G2, G5, G6, G7, or G8
+ *     dragFunction: G1, G2, G5, G6, G7, G8 or a drag curve number
  *               bC: Ballistic coefficient for the projectile
  *         velocity: Velocity of the projectile
  *
@@ -65,13 +154,85 @@ double libballistics_moa2mil(double moa, int spec);
 double libballistics_computeRetardation (int dragFunction, double bc, 
     double velocity);
 
+/* retardation_cursor: Remembers which piece of a drag function was used
+ *     last. Velocity changes slowly along a trajectory, so the next lookup
+ *     usually lands in the same piece and costs a single comparison. A
+ *     cursor may be copied but belongs to one trajectory at a time.
+ */
+
+struct retardation_segment;
+struct schedule_entry;
+struct drag_curve;
+struct atmosphere_table;
+
+typedef struct retardation_cursor {
+    const struct retardation_segment *segments;
+    int count;
+    int index;
+    const struct drag_curve *curve;     /* Set instead for drag curves */
+} *retardation_cursor_t;
+
+/* libballistics_initRetardationCursor: prepares a cursor for a drag function
+ * Arguments:
+ *           cursor: Cursor to initialize
+ *     dragFunction: G1, G2, G5, G6, G7, G8, or a libballistics_addDragCurve
+ *                   curve
+ */
+
+void libballistics_initRetardationCursor(retardation_cursor_t cursor,
+    int dragFunction);
+
+/* libballistics_computeCursorRetardation: libballistics_computeRetardation
+ *     using and advancing a cursor. Results are identical to
+ *     libballistics_computeRetardation for the cursor's drag function.
+ * Arguments:
+ *           cursor: Cursor from libballistics_initRetardationCursor
+ *               bC: Ballistic coefficient for the projectile
+ *         velocity: Velocity of the projectile
+ *
+ * Returns:
+ *    Projectile drag retardation velocity in fps
+ */
+
+double libballistics_computeCursorRetardation(retardation_cursor_t cursor,
+    double bC, double velocity);
+
+/* First drag function number given to curves, and how many there can be */
+#define LIBBALLISTICS_DRAG_CURVE        256
+#define LIBBALLISTICS_MAX_DRAG_CURVES   256
+
+/* libballistics_addDragCurve: registers a drag curve, such as one measured
+ *     by Doppler radar, for use wherever a drag function is taken. The
+ *     points are joined by a monotone cubic spline, which does not
+ *     overshoot between them; the Cd at the first and last points carries
+ *     on below and above them. As for the standard models, Mach numbers
+ *     are taken at the standard speed of sound and the ballistic
+ *     coefficient relative to the curve. A solve with a curve costs about
+ *     the same as one with a built-in model: solvers keep a cursor on the
+ *     spline piece in use and evaluate a cubic where the built-in models
+ *     call pow(). Curves last for the life of the process; register them
+ *     before solving on other threads. Numbers are given out in order of
+ *     registration, so they are only meaningful within one process.
+ * Arguments:
+ *      mach: Mach numbers, strictly increasing, from 0 to below 8.9
+ *            (10000 fps, where the solvers stop)
+ *        cd: Drag coefficient at each Mach number, positive
+ *     count: Number of points, at least 2
+ * Returns:
+ *     The drag function number for the curve, from LIBBALLISTICS_DRAG_CURVE
+ *     up, or -1 for invalid points, no memory or a full curve table
+ */
+
+int libballistics_addDragCurve(const double *mach, const double *cd,
+    int count);
+
 /* libballistics_dragForModel: returns the drag coefficient for the given
  *     drag model's standard 'G' bullet at the given velocity and
  *     temperature. This can be used to convert between different drag
  *     models.
  *
  * Arguments:
- *     dragFunction: G1, G2, G5, G6, G7, or G8
+ *     dragFunction: G1, G2, G5, G6, G7, G8 or a drag curve number
  *         velocity: Velocity of the projectile
  *      temperature: Ambient temperature (used to calculate the speed
  *          of sound, to calculate mach value)
@@ -82,6 +243,21 @@ double libballistics_computeRetardation (int dragFunction, double bc,
 double libballistics_dragForModel(int dragFunction, double velocity,
 	double temperature);
 
+/* libballistics_dragForModelArray: libballistics_dragForModel over arrays
+ *     of velocities and temperatures. Results are identical to calling
+ *     libballistics_dragForModel for each element.
+ *
+ * Arguments:
+ *     dragFunction: G1, G2, G5, G6, G7, G8 or a drag curve number
+ *         velocity: count velocities
+ *      temperature: count ambient temperatures, one per velocity
+ *               cd: receives count drag coefficients
+ *            count: number of elements
+ */
+
+void libballistics_dragForModelArray(int dragFunction, const double *velocity,
+	const double *temperature, double *cd, unsigned long count);
+
 /* libballistics_applyAtmosphere: Applies atmospheric conditions to an 
  *     existing BC 
  * Arguments:
@@ -147,6 +323,45 @@ double libballistics_crossWind (double windVelocity, double windAngle);
 double libballistics_computeZeroAngle(int DragFunction, double bC, 
     double velocity, double sightHeight, double zeroRange, double yIntercept);
 
+/* zero_solution: Result of libballistics_solveZeroAngle
+ * Elements:
+ *        angle: Bore angle for the zero (degrees)
+ *   iterations: Number of trial flights taken
+ *     residual: Height of the last trial flight above yIntercept at the
+ *               zero range (inches)
+ */
+
+typedef struct zero_solution {
+    double angle;
+    int iterations;
+    double residual;
+} *zero_solution_t;
+
+/* libballistics_solveZeroAngle: Compute bore angle needed for zero at given
+ *     range, like libballistics_computeZeroAngle, but converging in a few
+ *     trial flights rather than around twenty. Starts from a flat fire
+ *     estimate and refines it with secant updates; each trial flight stops
+ *     at the zero range. Converges to a residual below 0.0001 inches.
+ * Arguments:
+ *     dragFunction: G1, G2, G5, G6, G7, G8 or a drag curve number
+ *               bC: Ballistic coefficient for the projectile
+ *         velocity: Velocity of the projectile
+ *      sightHeight: Distance between bore centerline and center of
+ *                   scope / sight (inches)
+ *        zeroRange: Projectile intersect zero (yards)
+ *       yIntercept: Height for projectile when crossing zeroRange (inches),
+ *                   usually 0
+ *         solution: Receives the angle, iteration count and residual
+ * Returns:
+ *     0: operation successful
+ *    -1: no solution (the projectile cannot reach the zero range, or the
+ *        iteration did not converge); solution holds the last trial
+ */
+
+int libballistics_solveZeroAngle(int dragFunction, double bC,
+    double velocity, double sightHeight, double zeroRange, double yIntercept,
+    zero_solution_t solution);
+
 /* ballistic_coefficient: A single ballistic coefficient property for a
  *     projectile. One or more ballistic coefficients may be specified within
  *     a single ballistics calculation, based on velocity. Before computing
@@ -180,12 +395,193 @@ typedef struct trajectory_path {
     double velocityY;   /* Y Velocity */
 } *trajectory_path_t;
 
+/* trajectory_pathf: A trajectory_path in single precision, as written by
+ *     libballistics_computeTrajectoryBatchFloat */
+
+typedef struct trajectory_pathf {
+    float range;
+    float pathY;
+    float pathX;
+    float elevation;
+    float windage;
+    float time;
+    float velocity;
+    float velocityX;
+    float velocityY;
+} *trajectory_pathf_t;
+
+/* ballistics_sensitivity: Derivatives of one trajectory row with respect
+ *     to each BallisticParameter, at the row's fixed range. With several
+ *     ballistic coefficients, ParameterBC scales all of them in proportion
+ *     to the first one added.
+ * Elements:
+ *        pathY: Change of bullet path (inches per unit parameter)
+ *        pathX: Change of windage (inches per unit parameter)
+ *         time: Change of flight time (seconds per unit parameter)
+ */
+
+typedef struct ballistics_sensitivity {
+    double pathY[ParameterCount];
+    double pathX[ParameterCount];
+    double time[ParameterCount];
+} *ballistics_sensitivity_t;
+
+/* ballistics_sample_fn: Receives each sample of a streaming output
+ * Arguments:
+ *        arg: The output's 'arg'
+ *     values: Value of each wanted column, indexed by BallisticColumn;
+ *             unwanted columns are not set
+ *     sample: Number of the sample, from 0
+ * Returns:
+ *     0 to go on, or nonzero to stop the solve after this sample
+ */
+
+typedef int (*ballistics_sample_fn)(void *arg, const double *values,
+    unsigned long sample);
+
+/* ballistics_events: Events found during a solve, each at its first
+ *     occurrence, interpolated within the step it fell in
+ * Elements:
+ *   speedOfSound: Speed of sound for the Mach events (fps), set by the
+ *                 caller; zero means LIBBALLISTICS_SPEED_OF_SOUND
+ *          found: Mask of LIBBALLISTICS_EVENT(e) for the events that
+ *                 happened; the other entries are zero
+ *          range: Range of each BallisticEvent (yards)
+ *           time: Flight time to it (seconds)
+ *       velocity: Velocity there (fps)
+ *          pathY: Bullet path there (inches)
+ */
+
+typedef struct ballistics_events {
+    double speedOfSound;
+    unsigned int found;
+    double range[EventCount];
+    double time[EventCount];
+    double velocity[EventCount];
+    double pathY[EventCount];
+} *ballistics_events_t;
+
+/* ballistics_output: Sampled, column-per-array trajectory output. Rows are
+ *     taken every 'step' yards, or at each range in 'ranges', and each
+ *     wanted column is written to its own array as doubles or floats. Fill
+ *     one from a solved context with libballistics_getOutput, or attach it
+ *     with libballistics_setOutput to have the solver write samples
+ *     directly without keeping the per-yard table.
+ *     With a callback the output streams instead: each sample is passed to
+ *     the callback as the integrator crosses its range and nothing is
+ *     stored, so 'column', 'capacity' and 'precision' are ignored and a
+ *     solve needs no memory in proportion to its range. The callback may
+ *     stop the solve, which then returns the rows solved so far.
+ * Elements:
+ *         step: Sample every 'step' yards starting at 0 (0 means 1)
+ *       ranges: Ascending list of ranges (yards) to sample instead; NULL
+ *               to sample by step
+ *   rangeCount: Number of entries in ranges
+ *      columns: Mask of wanted columns, LIBBALLISTICS_COLUMN(ColumnPathY) |
+ *               ... or LIBBALLISTICS_ALL_COLUMNS
+ *    precision: OutputDouble or OutputFloat
+ *       column: Array for each wanted column, indexed by BallisticColumn,
+ *               holding double or float according to precision. Unwanted
+ *               columns may be NULL
+ *     capacity: Number of samples each column array holds
+ *      samples: Set to the number of samples written
+ *         next: Used by the library while sampling a range list
+ *     callback: Function receiving each sample, or NULL to fill columns
+ *          arg: Passed to callback
+ */
+
+typedef struct ballistics_output {
+    unsigned long step;
+    const unsigned long *ranges;
+    unsigned long rangeCount;
+    unsigned int columns;
+    int precision;
+    void *column[ColumnCount];
+    unsigned long capacity;
+    unsigned long samples;
+    unsigned long next;
+    ballistics_sample_fn callback;
+    void *arg;
+} *ballistics_output_t;
+
+/* ballistics_stats: Solver statistics of a context, accumulated over every
+ *     solve since they were enabled or last cleared. Statistics are only
+ *     kept by libraries configured with --enable-stats; see
+ *     libballistics_setStats.
+ * Elements:
+ *        enabled: StatsCounters, StatsTiming and StatsHardware flags
+ *         solves: Number of trajectories solved
+ *          steps: Integration steps, including rejected adaptive steps
+ *   retardations: Drag function evaluations
+ *      bcLookups: Ballistic coefficient lookups
+ *   bandSwitches: Changes of ballistic coefficient between velocity bands
+ *     zeroSolves: Number of libballistics_solveContextZero calls
+ * zeroIterations: Trial flights taken by those calls
+ *      phaseTime: Wall clock seconds spent in each BallisticPhase
+ *         cycles: CPU cycles spent solving
+ *   instructions: Instructions retired while solving
+ *   branchMisses: Mispredicted branches while solving
+ *       hardware: Performance counter descriptors used by the library
+ */
+
+typedef struct ballistics_stats {
+    int enabled;
+    unsigned long solves;
+    unsigned long steps;
+    unsigned long retardations;
+    unsigned long bcLookups;
+    unsigned long bandSwitches;
+    unsigned long zeroSolves;
+    unsigned long zeroIterations;
+    double phaseTime[PhaseCount];
+    unsigned long long cycles;
+    unsigned long long instructions;
+    unsigned long long branchMisses;
+    int hardware[3];
+} *ballistics_stats_t;
+
 /* ballistics_ctx: Context for a ballistic computation
  * Elements:
  *     trajectory: Pointer to allocated memory to store the trajectory solution
  *       maxRange: Maximum range computed for this computation
  *  maxValidRange: Automatically set by libballistics_computeTrajectory to
  *                 specify the maximum valid range
+ *     integrator: Integration method, set by libballistics_setIntegrator
+ *      tolerance: Local error tolerance for the adaptive integrator
+ *       capacity: Number of rows the trajectory buffer can hold
+ *       external: Nonzero when the trajectory buffer belongs to the caller
+ *                 (see libballistics_setTrajectoryBuffer)
+ *       readonly: Nonzero when the buffer is a card's table, which the
+ *                 library never writes (see libballistics_viewCard)
+ *       spareBCs: Coefficients released by libballistics_reset, reused by
+ *                 libballistics_addBallisticCoefficient
+ *         output: Sampled output written by the solver, set by
+ *                 libballistics_setOutput
+ *          steps: Set by libballistics_computeTrajectory to the number of
+ *                 integration steps taken (including rejected adaptive
+ *                 steps)
+ *          stats: Solver statistics, see libballistics_setStats
+ *       schedule: Drag schedule compiled from the coefficients for the
+ *                 current solve, used by the library
+ * scheduleCapacity: Number of schedule entries allocated
+ *  scheduleCount: Number of schedule entries in use
+ * scheduleLowest: Coefficient of the lowest velocity band
+ * muzzleVelocity: Muzzle velocity of the current solution
+ *       headwind: Headwind component of its wind (MPH)
+ *      crosswind: Crosswind component of its wind (MPH); see
+ *                 libballistics_setWind
+ *  sensitivities: Rows filled alongside the trajectory, set by
+ *                 libballistics_setSensitivities
+ * sensitivityCapacity: Number of rows they hold
+ *         events: Events filled by each solve, set by libballistics_setEvents
+ *     atmosphere: Air along the flight, set by libballistics_setAtmosphere,
+ *                 with the station conditions below
+ *       altitude: Station altitude (feet)
+ * barometricPressure: Station barometric pressure (Hg)
+ *    temperature: Station temperature (F)
+ * relativeHumidity: Station relative humidity (0.00 - 1.00)
+ *            air: Table of the air along the current solve, used by the
+ *                 library
  */
 
 typedef struct ballistics_ctx {
@@ -193,6 +589,31 @@ typedef struct ballistics_ctx {
 	unsigned long maxRange;
 	unsigned long maxValidRange;
 	ballistic_coefficient_t bCs;
+	int integrator;
+	double tolerance;
+	unsigned long capacity;
+	int external;
+	int readonly;
+	ballistic_coefficient_t spareBCs;
+	ballistics_output_t output;
+	unsigned long steps;
+	struct ballistics_stats stats;
+	struct schedule_entry *schedule;
+	unsigned long scheduleCapacity;
+	int scheduleCount;
+	double scheduleLowest;
+	double muzzleVelocity;
+	double headwind;
+	double crosswind;
+	ballistics_sensitivity_t sensitivities;
+	unsigned long sensitivityCapacity;
+	ballistics_events_t events;
+	int atmosphere;
+	double altitude;
+	double barometricPressure;
+	double temperature;
+	double relativeHumidity;
+	struct atmosphere_table *air;
 } *ballistics_ctx_t;
 
 /* libballistics_create: Creates a ballistic context
@@ -210,6 +631,134 @@ ballistics_ctx_t libballistics_create(void);
  */
 
 void libballistics_finish(ballistics_ctx_t context);
+
+/* libballistics_reset: Prepares a context for an unrelated computation.
+ * Removes its ballistic coefficients and clears the solution, but keeps
+ * its memory: the trajectory buffer is reused by the next solve (growing
+ * only if that solve needs more rows) and the coefficients are reused by
+ * libballistics_addBallisticCoefficient. A context that is reset between
+ * shots stops allocating once it has solved its longest shot. The
+ * integrator setting is kept.
+ *
+ * Arguments:
+ *     context: Pointer to the ballistic context to reset
+ */
+
+void libballistics_reset(ballistics_ctx_t context);
+
+/* libballistics_setTrajectoryBuffer: Makes the context store solutions in
+ * memory supplied by the caller instead of allocating its own. Solving
+ * out to maxRange yards needs maxRange + 2 rows. The buffer must stay
+ * valid until it is replaced or the context is finished; the library never
+ * frees it. Any solution already in the context is discarded.
+ *
+ * Arguments:
+ *     context: Pointer to the ballistic context
+ *      buffer: Memory for the trajectory table, or NULL to return to
+ *              buffers allocated by the library
+ *        rows: Number of rows the buffer holds
+ *
+ * Returns:
+ *     0: operation successful
+ */
+
+int libballistics_setTrajectoryBuffer(ballistics_ctx_t context,
+	trajectory_path_t buffer, unsigned long rows);
+
+/* libballistics_setSensitivities: Makes libballistics_computeTrajectory
+ * also compute how each row moves with the muzzle velocity, ballistic
+ * coefficient, zero and line of sight angles and wind velocity. The
+ * tangent (variational) equations are integrated in the same loop and by
+ * the same method as the flight, so one solve replaces a set of perturbed
+ * ones and the derivatives carry no finite difference noise. Row n of
+ * 'rows' receives range n; rows the flight does not reach are zeroed, and
+ * a solve fails if 'rows' holds fewer than maxRange + 1 rows. The library
+ * never frees the buffer.
+ *
+ * Arguments:
+ *     context: Pointer to the ballistic context
+ *        rows: Array receiving the derivatives, or NULL to stop computing
+ *              them
+ *       count: Number of rows in the array
+ *
+ * Returns:
+ *     0: operation successful
+ */
+
+int libballistics_setSensitivities(ballistics_ctx_t context,
+	ballistics_sensitivity_t rows, unsigned long count);
+
+/* libballistics_setAtmosphere: Makes libballistics_computeTrajectory vary
+ * the air with the projectile's height, for steep mountain and high angle
+ * shots where one correction at the muzzle (libballistics_applyAtmosphere)
+ * is off. With AtmosphereStandard the air at the muzzle is that of the
+ * station conditions given, and above or below it temperature follows the
+ * standard lapse rate and density the standard atmosphere; the speed of
+ * sound, and so the Mach number the drag function sees, follows the
+ * temperature. Pass uncorrected ballistic coefficients. Each solve fills a
+ * small table of the air over the heights it can reach, so a step costs
+ * one interpolation more. libballistics_solveMaxPBR flies its trials in
+ * the same air. Sensitivities treat the air along the flight as fixed, and
+ * Mach events still use the events' speed of sound. Zero angles and the
+ * other solvers that take no context are unaffected; neither the solution
+ * cache nor card files hold solves made with it.
+ *
+ * Arguments:
+ *            context: Pointer to the ballistic context
+ *         atmosphere: AtmosphereNone or AtmosphereStandard
+ *           altitude: Station altitude above sea level (feet)
+ * barometricPressure: Station barometric pressure (Hg)
+ *        temperature: Station temperature (F)
+ *   relativeHumidity: Station relative humidity (0.00 - 1.00)
+ *
+ * Returns:
+ *     0: operation successful
+ *    -1: unknown atmosphere, invalid conditions or no memory
+ */
+
+int libballistics_setAtmosphere(ballistics_ctx_t context, int atmosphere,
+	double altitude, double barometricPressure, double temperature,
+	double relativeHumidity);
+
+/* libballistics_setEvents: Makes libballistics_computeTrajectory watch
+ * for each BallisticEvent as it integrates and record where it first
+ * happens. Events are located within the step they fall in, on the
+ * adaptive integrator's continuous extension or linearly between the fixed
+ * integrator's steps, so they do not fall on whole yards. Each solve
+ * clears the events before filling them, and works with a table or a
+ * sampled output alike.
+ *
+ * Arguments:
+ *     context: Pointer to the ballistic context
+ *      events: Events to fill on each solve, or NULL to stop detecting
+ *              them. Must stay valid while attached
+ *
+ * Returns:
+ *     0: operation successful
+ */
+
+int libballistics_setEvents(ballistics_ctx_t context,
+	ballistics_events_t events);
+
+/* libballistics_setOutput: Makes libballistics_computeTrajectory write
+ * sampled columns into 'output' instead of building the per-yard table.
+ * Only the wanted rows and columns are computed and stored, so the solve
+ * touches a fraction of the memory. An output with a callback streams its
+ * samples and may stop the solve early (see ballistics_output). While an
+ * output is attached the context keeps no table, and the data retrieval
+ * functions return 0.
+ *
+ * Arguments:
+ *     context: Pointer to the ballistic context
+ *      output: Output to fill on each solve, or NULL to go back to
+ *              per-yard tables. Must stay valid while attached
+ *
+ * Returns:
+ *     0: operation successful
+ */
+
+int libballistics_setOutput(ballistics_ctx_t context,
+	ballistics_output_t output);
  
 /* libballistics_addBallisticCoefficient: Add a ballistic coefficient to a
  * ballistics context. Some projectiles (such as Sierra) are documented with 
@@ -232,6 +781,184 @@ void libballistics_finish(ballistics_ctx_t context);
 int libballistics_addBallisticCoefficient(ballistics_ctx_t context, 
 	double bC, double minFPS, double maxFPS);
 
+/* libballistics_setIntegrator: Select how libballistics_computeTrajectory
+ * integrates the flight. EulerIntegrator, the default, takes fixed steps.
+ * AdaptiveIntegrator sizes its steps to keep the local error within a
+ * tolerance and interpolates each row at its exact range, so it needs far
+ * fewer drag evaluations for the same accuracy. 1e-8 is a good tolerance;
+ * smaller values are more accurate and slower.
+ *
+ * Arguments:
+ *     context: pointer to the ballistic context
+ *  integrator: EulerIntegrator or AdaptiveIntegrator
+ *   tolerance: relative local error tolerance for AdaptiveIntegrator
+ *              (use zero for the default of 1e-8)
+ *
+ * Returns:
+ *     0: operation successful
+ *    -1: unknown integrator or negative tolerance
+ */
+
+int libballistics_setIntegrator(ballistics_ctx_t context, int integrator,
+	double tolerance);
+
+/* libballistics_setStats: Choose which statistics the context keeps in
+ * context->stats. Counting and timing are compiled out of the library
+ * unless it is configured with --enable-stats, and even then cost nothing
+ * until enabled here. StatsHardware reads the CPU's performance counters
+ * through perf_event_open(2) around each solve; the counters follow the
+ * calling thread, so the context must then be used on that thread only.
+ * Enabling statistics does not clear those already gathered.
+ *
+ * Arguments:
+ *     context: pointer to the ballistic context
+ *       flags: StatsCounters, StatsTiming and StatsHardware or'ed
+ *              together, or zero to stop gathering statistics
+ *
+ * Returns:
+ *     0: operation successful
+ *    -1: the library was built without statistics, or the hardware
+ *        counters are unavailable; everything else requested is enabled
+ */
+
+int libballistics_setStats(ballistics_ctx_t context, int flags);
+
+/* libballistics_clearStats: Zero the statistics of a context, leaving the
+ * enabled flags as they are.
+ *
+ * Arguments:
+ *     context: pointer to the ballistic context
+ */
+
+void libballistics_clearStats(ballistics_ctx_t context);
+
+/* libballistics_solveContextZero: libballistics_solveZeroAngle for a
+ *     projectile described by a context's ballistic coefficients, which
+ *     may cover several velocity bands. The context's statistics count
+ *     the solve and its trial flights.
+ * Arguments:
+ *          context: Pointer to a ballistic context with at least one
+ *                   ballistic coefficient
+ *     dragFunction: G1, G2, G5, G6, G7, G8 or a drag curve number
+ *         velocity: Velocity of the projectile
+ *      sightHeight: Distance between bore centerline and center of
+ *                   scope / sight (inches)
+ *        zeroRange: Projectile intersect zero (yards)
+ *       yIntercept: Height for projectile when crossing zeroRange (inches),
+ *                   usually 0
+ *         solution: Receives the angle, iteration count and residual
+ * Returns:
+ *     0: operation successful
+ *    -1: no solution, as for libballistics_solveZeroAngle
+ */
+
+int libballistics_solveContextZero(ballistics_ctx_t context,
+    int dragFunction, double velocity, double sightHeight, double zeroRange,
+    double yIntercept, zero_solution_t solution);
+
+/* ballistics_pbr: Result of libballistics_solveMaxPBR. Heights are from
+ *     the line of sight.
+ * Elements:
+ *          angle: Bore angle (degrees)
+ *       nearZero: Range where the path rises through the line of sight
+ *                 (yards), zero if it starts on or above it
+ *        farZero: Range where the path falls back through it (yards)
+ *      apexRange: Range of the highest point (yards)
+ *     apexHeight: Height of the highest point (inches), the vital zone
+ *                 radius
+ *       minRange: Near limit of point blank range, where the path rises
+ *                 into the vital zone (yards), zero if it starts in it
+ *       maxRange: Far limit of point blank range, where the path falls
+ *                 out of the vital zone (yards)
+ *     iterations: Number of trial flights taken
+ */
+
+typedef struct ballistics_pbr {
+    double angle;
+    double nearZero;
+    double farZero;
+    double apexRange;
+    double apexHeight;
+    double minRange;
+    double maxRange;
+    int iterations;
+} *ballistics_pbr_t;
+
+/* libballistics_solveMaxPBR: Finds the zero giving the longest point blank
+ *     range for a vital zone, without choosing a zero range first. The far
+ *     limit grows with the bore angle until the apex leaves the zone, so
+ *     the best angle puts the apex on the top of the zone; it is found with
+ *     secant updates, each trial one flight that records its apex and
+ *     crossings and stops at the far limit. Converges to an apex within
+ *     0.0001 inches of the radius, usually in four or five flights. The
+ *     line of sight is level and there is no wind; the air is the
+ *     context's (see libballistics_setAtmosphere).
+ * Arguments:
+ *             context: Pointer to a ballistic context with at least one
+ *                      ballistic coefficient
+ *        dragFunction: G1, G2, G5, G6, G7, or G8
+ *            velocity: Velocity of the projectile
+ *         sightHeight: Distance between bore centerline and center of
+ *                      scope / sight (inches)
+ *     vitalZoneRadius: Radius of the vital zone (inches)
+ *                 pbr: Receives the angle, zeros, apex and limits
+ * Returns:
+ *     0: operation successful
+ *    -1: no solution (the flight stalls or the iteration did not
+ *        converge); pbr holds the last trial
+ */
+
+int libballistics_solveMaxPBR(ballistics_ctx_t context, int dragFunction,
+    double velocity, double sightHeight, double vitalZoneRadius,
+    ballistics_pbr_t pbr);
+
+/* libballistics_computeWindSweep: Windage for many winds from one solution.
+ *     Crosswind only enters the pathX and windage columns, and linearly, so
+ *     the context's solution gives them for any crosswind without solving
+ *     again. Headwind changes the flight itself: winds whose headwind
+ *     differs from the solution's (by more than 1e-6 MPH) are flagged, and
+ *     their columns only account for their crosswind.
+ * Arguments:
+ *          context: Context holding a trajectory table
+ *     windVelocity: Wind velocity of each wind (MPH)
+ *        windAngle: Wind angle of each wind (degrees)
+ *            count: Number of winds
+ *           stride: Number of rows each wind has room for in pathX and
+ *                   windage
+ *            pathX: Receives the pathX column of wind i at
+ *                   pathX[i * stride], or NULL
+ *          windage: Receives the windage column likewise, or NULL
+ *            flags: Receives 1 for each wind that would need a new
+ *                   solution and 0 otherwise, or NULL
+ * Returns:
+ *     Number of rows written for each wind (the table's rows, up to
+ *     stride), or -1 if the context has no table
+ */
+
+int libballistics_computeWindSweep(ballistics_ctx_t context,
+    const double *windVelocity, const double *windAngle, int count,
+    unsigned long stride, double *pathX, double *windage, int *flags);
+
+/* libballistics_setWind: Change the wind of a solution in place. When only
+ *     the crosswind changes, the pathX and windage columns are rewritten
+ *     and the rest of the table stays valid. A different headwind (by more
+ *     than 1e-6 MPH) changes the whole flight; the table is then left
+ *     alone and the trajectory must be solved again. A context viewing a
+ *     card (libballistics_viewCard) gets a copy of the card's rows to
+ *     rewrite.
+ * Arguments:
+ *          context: Context holding a trajectory table
+ *     windVelocity: New wind velocity (MPH)
+ *        windAngle: New wind angle (degrees)
+ * Returns:
+ *     0: wind updated
+ *     1: the headwind changed; solve the trajectory again
+ *    -1: the context has no table, or copying a card's rows failed
+ */
+
+int libballistics_setWind(ballistics_ctx_t context, double windVelocity,
+    double windAngle);
+
 /* libballistics_computeTrajectory: Generate a ballistics solution table 
  *     in 1 yard increments 
  * Arguments:
@@ -256,7 +983,11 @@ int libballistics_addBallisticCoefficient(ballistics_ctx_t context,
  *         maxRange: Maximum range to compute for
  * Returns:
  *     Integer specifying the maximum valid range (and number of entries) 
- *     within the trajectory table.
+ *     within the trajectory table, or -1 if the table could not be
+ *     allocated or does not fit a caller-supplied buffer.
+ *
+ *     The context's trajectory buffer is reused from one call to the next,
+ *     so a table is overwritten by the following computation.
  */
 
 int libballistics_computeTrajectory(ballistics_ctx_t context, int dragFunction,
@@ -264,6 +995,659 @@ int libballistics_computeTrajectory(ballistics_ctx_t context, int dragFunction,
     double zeroAngle, double windVelocity, double windAngle, 
     unsigned long maxRange);
 
+/* ballistics_batch: A set of shots to be solved together by
+ *     libballistics_computeTrajectoryBatch. Inputs are laid out as parallel
+ *     arrays (one element per shot) so that several shots can be integrated
+ *     side by side in SIMD lanes.
+ * Elements:
+ *            count: Number of shots in the batch
+ *     dragFunction: Drag function of each shot (G1, G2, G5, G6, G7, or G8)
+ *         velocity: Muzzle velocity of each shot (fps)
+ *      sightHeight: Sight height of each shot (inches)
+ *         losAngle: Line-of-sight angle of each shot (degrees)
+ *        zeroAngle: Zero angle of each shot (degrees)
+ *     windVelocity: Wind velocity of each shot (MPH)
+ *        windAngle: Wind angle of each shot (degrees)
+ *          bcIndex: count + 1 offsets into bC, minFPS and maxFPS. Shot i uses
+ *                   the BC bands bcIndex[i] through bcIndex[i + 1] - 1
+ *               bC: Ballistic coefficient of each band
+ *           minFPS: Minimum velocity of each band (see
+ *                   libballistics_addBallisticCoefficient)
+ *           maxFPS: Maximum velocity of each band (zero for no limit)
+ */
+
+typedef struct ballistics_batch {
+    unsigned long count;
+    const int *dragFunction;
+    const double *velocity;
+    const double *sightHeight;
+    const double *losAngle;
+    const double *zeroAngle;
+    const double *windVelocity;
+    const double *windAngle;
+    const unsigned long *bcIndex;
+    const double *bC;
+    const double *minFPS;
+    const double *maxFPS;
+} *ballistics_batch_t;
+
+/* libballistics_computeTrajectoryBatch: Generate ballistics solution tables
+ *     for every shot in a batch, in 1 yard increments. Shots are integrated
+ *     several at a time using the SIMD kernel for libballistics_getSimdLevel
+ *     (SSE2: 2 lanes, AVX2: 4 lanes, AVX-512: 8 lanes); a lane
+ *     is handed the next shot as soon as its current shot terminates.
+ *
+ *     Each table matches the one libballistics_computeTrajectory produces
+ *     for the same shot to within a relative difference of 1e-9 in every
+ *     column. The kernels evaluate the drag power law with a vectorized
+ *     exp/log in place of pow(), which accounts for the difference.
+ *     Shots using a drag curve (libballistics_addDragCurve) are solved
+ *     one at a time by libballistics_computeTrajectory after the kernel.
+ * Arguments:
+ *        batch: Shots to solve
+ *     maxRange: Maximum range to compute for
+ *        paths: Output tables; room for batch->count * (maxRange + 1) rows.
+ *               The table for shot i starts at paths + i * (maxRange + 1)
+ *         rows: Output; number of valid rows in each shot's table (the
+ *               value libballistics_computeTrajectory would return). Rows
+ *               past this count are left untouched
+ * Returns:
+ *     0: operation successful
+ *    -1: invalid arguments
+ */
+
+int libballistics_computeTrajectoryBatch(const struct ballistics_batch *batch,
+    unsigned long maxRange, trajectory_path_t paths, int *rows);
+
+/* libballistics_computeTrajectoryBatchFloat: libballistics_computeTrajectoryBatch
+ *     in single precision. The kernels hold their state in floats, so each
+ *     vector carries twice as many shots (SSE2: 4 lanes, AVX2: 8, AVX-512:
+ *     16), and the tables take half the memory. Time, position and
+ *     velocity are summed with compensation and rows are worked out in
+ *     double before rounding. A row may be recorded a step before or after
+ *     the double solver's, but at the same range, out to 2000 yards, path
+ *     and windage stay within about 0.01 inch of the double solver and time
+ *     within about 10 microseconds; the bench "float" suite measures this
+ *     for each drag model.
+ * Arguments:
+ *        batch: Shots to solve
+ *     maxRange: Maximum range to compute for
+ *        paths: Output tables; room for batch->count * (maxRange + 1) rows
+ *               laid out as for libballistics_computeTrajectoryBatch
+ *         rows: Output; number of valid rows in each shot's table
+ * Returns:
+ *     0: operation successful
+ *    -1: invalid arguments
+ */
+
+int libballistics_computeTrajectoryBatchFloat(
+    const struct ballistics_batch *batch, unsigned long maxRange,
+    trajectory_pathf_t paths, int *rows);
+
+/* libballistics_getSimdLevel: returns the instruction set the vectorized
+ *     kernels (libballistics_computeTrajectoryBatch, its Float variant and
+ *     libballistics_dragForModelArray) run with. This is the best the
+ *     processor supports, unless the LIBBALLISTICS_SIMD environment
+ *     variable names a lower one (generic, sse2, avx2 or avx512) or
+ *     libballistics_setSimdLevel has chosen one.
+ * Returns:
+ *     One of SimdGeneric, SimdSSE2, SimdAVX2 or SimdAVX512
+ */
+
+int libballistics_getSimdLevel(void);
+
+/* libballistics_setSimdLevel: chooses the instruction set for the
+ *     vectorized kernels, to compare or test each one on a single machine.
+ *     Levels above what the processor supports are lowered to it. Call
+ *     this before starting solves on other threads.
+ * Arguments:
+ *     level: SimdGeneric ... SimdAVX512, or -1 to go back to the default
+ *            (the processor's best, or LIBBALLISTICS_SIMD)
+ * Returns:
+ *     The level now in use
+ */
+
+int libballistics_setSimdLevel(int level);
+
+/* libballistics_getSimdName: returns a level's name as LIBBALLISTICS_SIMD
+ *     takes it ("generic", "sse2", "avx2", "avx512"), or NULL for an
+ *     unknown level
+ */
+
+const char *libballistics_getSimdName(int level);
+
+/* ballistics_sweep_job: One point of a sweep grid, as passed to the sink
+ * Elements:
+ *           index: Position of the point in the grid (see ballistics_sweep)
+ *          worker: Thread solving the point, from 0 to threads - 1
+ *     velocity ... maxRange: Parameter values for the point
+ */
+
+typedef struct ballistics_sweep_job {
+    unsigned long index;
+    int worker;
+    double velocity;
+    double bC;
+    double losAngle;
+    double zeroAngle;
+    double windVelocity;
+    double windAngle;
+    unsigned long maxRange;
+} *ballistics_sweep_job_t;
+
+/* ballistics_sweep: A grid of trajectories for libballistics_computeSweep.
+ *     Each axis is an array of values and its length; the grid is every
+ *     combination. Points are indexed with velocity varying slowest and
+ *     maxRange fastest.
+ * Elements:
+ *     dragFunction: Drag function (G1, G2, G5, G6, G7, or G8)
+ *      sightHeight: Sight height (inches)
+ *       integrator: EulerIntegrator or AdaptiveIntegrator
+ *        tolerance: Tolerance for AdaptiveIntegrator (zero for default)
+ *         velocity: Muzzle velocities (fps)
+ *               bC: Ballistic coefficients
+ *         losAngle: Line-of-sight angles (degrees)
+ *        zeroAngle: Zero angles (degrees)
+ *     windVelocity: Wind velocities (MPH)
+ *        windAngle: Wind angles (degrees)
+ *         maxRange: Maximum ranges to compute for (yards)
+ *          threads: Number of threads; zero for one per online processor
+ *             sink: Called with each solved point, the context holding
+ *                   its trajectory (only valid during the call) and the
+ *                   row count from libballistics_computeTrajectory.
+ *                   Calls come from several threads at once; the sink must
+ *                   do its own locking
+ *              arg: Passed to the sink
+ */
+
+typedef struct ballistics_sweep {
+    int dragFunction;
+    double sightHeight;
+    int integrator;
+    double tolerance;
+    const double *velocity;
+    unsigned long velocityCount;
+    const double *bC;
+    unsigned long bCCount;
+    const double *losAngle;
+    unsigned long losAngleCount;
+    const double *zeroAngle;
+    unsigned long zeroAngleCount;
+    const double *windVelocity;
+    unsigned long windVelocityCount;
+    const double *windAngle;
+    unsigned long windAngleCount;
+    const unsigned long *maxRange;
+    unsigned long maxRangeCount;
+    int threads;
+    void (*sink)(void *arg, const struct ballistics_sweep_job *job,
+        ballistics_ctx_t context, int rows);
+    void *arg;
+} *ballistics_sweep_t;
+
+/* libballistics_computeSweep: Solve every trajectory in a sweep grid on a
+ *     pool of threads. Points are ordered by estimated cost, most expensive
+ *     first, and dealt out to per-thread queues; a thread whose queue runs
+ *     dry steals the cheapest remaining points from the others. Each thread
+ *     reuses one context for all of its points.
+ * Arguments:
+ *     sweep: Grid to solve
+ * Returns:
+ *     0: operation successful
+ *    -1: invalid arguments or out of memory
+ */
+
+int libballistics_computeSweep(const struct ballistics_sweep *sweep);
+
+/* ballistics_shot: Complete description of a shot, as used by the solution
+ *     cache. Every field takes part in the cache key.
+ * Elements:
+ *       dragFunction: G1, G2, G5, G6, G7, or G8
+ *            bcCount: Number of ballistic coefficient bands
+ *                 bC: Ballistic coefficient of each band
+ *             minFPS: Minimum velocity of each band, or NULL for no limits
+ *                     (see libballistics_addBallisticCoefficient)
+ *             maxFPS: Maximum velocity of each band, or NULL
+ *           velocity: Muzzle velocity (fps)
+ *        sightHeight: Sight height (inches)
+ *           losAngle: Line-of-sight angle (degrees)
+ *          zeroAngle: Zero angle (degrees)
+ *       windVelocity: Wind velocity (MPH)
+ *          windAngle: Wind angle (degrees)
+ *         atmosphere: Nonzero to correct every coefficient with
+ *                     libballistics_applyAtmosphere and the four
+ *                     conditions below, which are otherwise ignored
+ *           altitude: Altitude (feet)
+ * barometricPressure: Barometric pressure (Hg)
+ *        temperature: Temperature (F)
+ *   relativeHumidity: Relative humidity (0.00 - 1.00)
+ *         integrator: EulerIntegrator or AdaptiveIntegrator
+ *          tolerance: Tolerance for AdaptiveIntegrator (zero for default)
+ */
+
+typedef struct ballistics_shot {
+    int dragFunction;
+    unsigned long bcCount;
+    const double *bC;
+    const double *minFPS;
+    const double *maxFPS;
+    double velocity;
+    double sightHeight;
+    double losAngle;
+    double zeroAngle;
+    double windVelocity;
+    double windAngle;
+    int atmosphere;
+    double altitude;
+    double barometricPressure;
+    double temperature;
+    double relativeHumidity;
+    int integrator;
+    double tolerance;
+} *ballistics_shot_t;
+
+/* ballistics_cache_stats: Counters of a solution cache
+ * Elements:
+ *         hits: Lookups answered from the cache
+ *       misses: Lookups that had to be solved
+ *   insertions: Solutions stored
+ *    evictions: Solutions dropped to stay within the size limit
+ *      entries: Solutions held now
+ *        bytes: Memory held now, counted as in libballistics_createCache
+ */
+
+typedef struct ballistics_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long insertions;
+    unsigned long evictions;
+    unsigned long entries;
+    unsigned long bytes;
+} *ballistics_cache_stats_t;
+
+typedef struct ballistics_cache *ballistics_cache_t;
+
+/* libballistics_createCache: Creates a cache of zero angles and trajectory
+ *     tables that any number of threads may share. Entries are spread over
+ *     independently locked shards by the hash of their shot, and each shard
+ *     evicts with the CLOCK algorithm (an approximation of least recently
+ *     used) when its share of the size limit is exceeded.
+ * Arguments:
+ *     bytes: Size limit, covering the tables, keys and bookkeeping
+ *    shards: Number of shards (rounded up to a power of two), or zero for
+ *            the default of 16
+ * Returns:
+ *     Pointer to the new cache, or NULL if out of memory
+ */
+
+ballistics_cache_t libballistics_createCache(unsigned long bytes, int shards);
+
+/* libballistics_finishCache: Frees a cache and everything in it
+ * libballistics_clearCache: Empties a cache and zeroes its counters
+ * Arguments:
+ *     cache: The cache
+ */
+
+void libballistics_finishCache(ballistics_cache_t cache);
+void libballistics_clearCache(ballistics_cache_t cache);
+
+/* libballistics_cacheZeroAngle: libballistics_computeZeroAngle, answered
+ *     from the cache when the same zero has been asked for before. The
+ *     zero is computed with the shot's first (corrected) ballistic
+ *     coefficient; the angles and wind of the shot do not matter.
+ * Arguments:
+ *          cache: The cache
+ *           shot: Projectile, sight and atmosphere
+ *      zeroRange: Projectile intersect zero (yards)
+ *     yIntercept: Height for projectile when crossing zeroRange (inches)
+ * Returns:
+ *     Bore angle (degrees), or zero if the shot has no coefficient
+ */
+
+double libballistics_cacheZeroAngle(ballistics_cache_t cache,
+    const struct ballistics_shot *shot, double zeroRange, double yIntercept);
+
+/* libballistics_cacheTrajectory: libballistics_computeTrajectory for a
+ *     shot, answered from the cache when possible. A table cached for a
+ *     longer range also answers shorter ones, so requests that only vary
+ *     the range share one solve. The context's coefficients and integrator
+ *     are replaced by the shot's. The rows, or the sampled output if the
+ *     context has one, are those a direct solve would give; steps is zero
+ *     on a hit, and maxValidRange of a table cut from a longer one is
+ *     capped at maxRange. The cache holds no sensitivities or events, so a
+ *     context computing them always solves, then stores the table it
+ *     solved. A context whose air varies along the flight, set with
+ *     libballistics_setAtmosphere, always solves and stores nothing. A
+ *     streaming output is fed from the finished table, so a callback that
+ *     stops early saves no solving on a miss.
+ * Arguments:
+ *       cache: The cache
+ *        shot: Shot to solve
+ *     context: Context that receives the solution
+ *    maxRange: Maximum range of the solution (yards)
+ * Returns:
+ *     As libballistics_computeTrajectory
+ */
+
+int libballistics_cacheTrajectory(ballistics_cache_t cache,
+    const struct ballistics_shot *shot, ballistics_ctx_t context,
+    unsigned long maxRange);
+
+/* libballistics_getCacheStats: Reads a cache's counters
+ * Arguments:
+ *     cache: The cache
+ *     stats: Receives the counters
+ */
+
+void libballistics_getCacheStats(ballistics_cache_t cache,
+    ballistics_cache_stats_t stats);
+
+/* ballistics_dispersion: What varies from shot to shot, for
+ *     libballistics_computeHitProbability. Every spread is the standard
+ *     deviation of a normal distribution around the nominal shot's value.
+ * Elements:
+ *            range: Target range (yards)
+ *      targetWidth: Target width (inches)
+ *     targetHeight: Target height (inches)
+ *      roundTarget: Nonzero for an ellipse of that width and height
+ *                   instead of a rectangle
+ *         velocity: Muzzle velocity spread (fps)
+ *               bC: Ballistic coefficient spread, as a fraction of each
+ *                   coefficient
+ *     windVelocity: Wind velocity spread (MPH)
+ *        windAngle: Wind angle spread (degrees)
+ *       rangeError: Error of the range estimate the shot is held for
+ *                   (yards)
+ *        precision: Spread of the rifle and shooter on each axis (MOA)
+ *          samples: Maximum number of shots to simulate
+ *        tolerance: Stop early once the 95% confidence interval of the hit
+ *                   probability is within +/- tolerance; zero to simulate
+ *                   every sample
+ *             seed: Random seed. Results depend only on the seed and the
+ *                   inputs, not on the number of threads
+ *          threads: Number of threads; zero for one per online processor
+ */
+
+typedef struct ballistics_dispersion {
+    double range;
+    double targetWidth;
+    double targetHeight;
+    int roundTarget;
+    double velocity;
+    double bC;
+    double windVelocity;
+    double windAngle;
+    double rangeError;
+    double precision;
+    unsigned long samples;
+    double tolerance;
+    unsigned long long seed;
+    int threads;
+} *ballistics_dispersion_t;
+
+/* ballistics_hit: Result of libballistics_computeHitProbability. Impacts
+ *     are measured from the point of aim, in inches.
+ * Elements:
+ *          samples: Shots simulated
+ *             hits: Shots that hit the target
+ *      probability: hits / samples
+ *            lower: Lower end of the 95% confidence interval (Wilson)
+ *            upper: Upper end of it
+ *          reached: Shots whose flight reached the target; the others
+ *                   count as misses
+ *     meanX, meanY: Mean impact (windage and elevation) of those shots
+ *         sdX, sdY: Standard deviation of their impacts
+ */
+
+typedef struct ballistics_hit {
+    unsigned long samples;
+    unsigned long hits;
+    double probability;
+    double lower;
+    double upper;
+    unsigned long reached;
+    double meanX;
+    double meanY;
+    double sdX;
+    double sdY;
+} *ballistics_hit_t;
+
+/* libballistics_computeHitProbability: Estimates the chance of hitting a
+ *     target by simulating shots. The shooter holds for the nominal shot
+ *     at the estimated range: the point of aim is where the nominal
+ *     trajectory crosses that range, and the line of sight moves with the
+ *     true range in proportion. Each simulated shot draws its muzzle
+ *     velocity, coefficients, wind, true range and aim error, and its
+ *     flight is solved only out to the true range. Shots are simulated on
+ *     a pool of threads in fixed blocks, each block with its own random
+ *     stream, and the confidence interval is checked after every round of
+ *     blocks.
+ * Arguments:
+ *           shot: Nominal shot, zeroed (zeroAngle) for the nominal load
+ *     dispersion: Target and spreads
+ *            hit: Receives the estimate and impact statistics
+ * Returns:
+ *     0: operation successful
+ *    -1: invalid arguments, out of memory, or the nominal shot does not
+ *        reach the target
+ */
+
+int libballistics_computeHitProbability(const struct ballistics_shot *shot,
+    const struct ballistics_dispersion *dispersion, ballistics_hit_t hit);
+
+/* ballistics_grid_spec: Layout of a solution grid for
+ *     libballistics_createGrid. BC and muzzle velocity are sampled evenly
+ *     between their limits (inclusive); every node is zeroed for the same
+ *     sight, and its path stored every 'step' yards out to maxRange.
+ * Elements:
+ *     dragFunction: Drag functions to cover
+ *        dragCount: Number of drag functions
+ *     bCMin, bCMax: BC limits
+ *          bCCount: Number of BC nodes (at least 2)
+ *      velocityMin: Muzzle velocity limits (fps)
+ *      velocityMax
+ *    velocityCount: Number of velocity nodes (at least 2)
+ *      sightHeight: Sight height (inches)
+ *        zeroRange: Zero range (yards)
+ *         maxRange: Longest range stored (yards)
+ *             step: Yards between stored rows (zero means 10)
+ *    interpolation: InterpolateLinear or InterpolateCubic
+ *          threads: Threads to build with; zero for one per online processor
+ */
+
+typedef struct ballistics_grid_spec {
+    const int *dragFunction;
+    int dragCount;
+    double bCMin, bCMax;
+    int bCCount;
+    double velocityMin, velocityMax;
+    int velocityCount;
+    double sightHeight;
+    unsigned long zeroRange;
+    unsigned long maxRange;
+    unsigned long step;
+    int interpolation;
+    int threads;
+} *ballistics_grid_spec_t;
+
+/* ballistics_grid_answer: Result of libballistics_queryGrid
+ * Elements:
+ *            pathY: Bullet path (inches)
+ *            pathX: Windage (inches)
+ *             time: Flight time (seconds)
+ *       pathYError: Estimated error of pathY (inches)
+ *       pathXError: Estimated error of pathX (inches)
+ *        timeError: Estimated error of time (seconds)
+ */
+
+typedef struct ballistics_grid_answer {
+    double pathY;
+    double pathX;
+    double time;
+    double pathYError;
+    double pathXError;
+    double timeError;
+} *ballistics_grid_answer_t;
+
+typedef struct ballistics_grid *ballistics_grid_t;
+
+/* libballistics_createGrid: Precomputes trajectories over a grid of drag
+ *     function, BC and muzzle velocity at standard conditions, for
+ *     libballistics_queryGrid to interpolate. Each node is solved with the
+ *     adaptive integrator at a tight tolerance so that rows lie exactly on
+ *     their ranges. Nodes that cannot reach the zero range or maxRange
+ *     leave holes the queries around them cannot use.
+ * Arguments:
+ *     spec: Grid layout
+ * Returns:
+ *     Pointer to the new grid, or NULL on invalid arguments or out of
+ *     memory
+ */
+
+ballistics_grid_t libballistics_createGrid(const struct ballistics_grid_spec
+    *spec);
+
+/* libballistics_finishGrid: Frees a grid
+ * Arguments:
+ *     grid: The grid
+ */
+
+void libballistics_finishGrid(ballistics_grid_t grid);
+
+/* libballistics_queryGrid: Interpolates a trajectory from a grid in place
+ *     of solving it; a query takes a few hundred nanoseconds. Every answer
+ *     is interpolated both multilinearly and by cubics, and the difference
+ *     between the two is the error estimate. That bounds the error of the
+ *     linear answer and overstates that of the cubic one, which is usually
+ *     far smaller. Other atmospheres are queried with the BC corrected by
+ *     libballistics_applyAtmosphere, as for the solvers.
+ * Arguments:
+ *             grid: The grid
+ *     dragFunction: One of the grid's drag functions
+ *               bC: Ballistic coefficient, within the grid's limits
+ *         velocity: Muzzle velocity (fps), within the grid's limits
+ *            range: Range (yards), up to the grid's maxRange
+ *        crosswind: Crosswind component (MPH) for pathX
+ *           answer: Receives the result
+ * Returns:
+ *     0: operation successful
+ *    -1: outside the grid, or too close to a node that has no solution
+ */
+
+int libballistics_queryGrid(ballistics_grid_t grid, int dragFunction,
+    double bC, double velocity, double range, double crosswind,
+    ballistics_grid_answer_t answer);
+
+/* libballistics_saveGrid: Writes a grid to a file
+ * libballistics_loadGrid: Reads a grid written by libballistics_saveGrid.
+ *     The file is a short header followed by the node data as written, so
+ *     it loads in one read. Files from a machine of the other byte order,
+ *     or whose header is damaged or describes a grid too large to
+ *     allocate, are refused.
+ * Arguments:
+ *     grid: The grid
+ *     path: File name
+ * Returns:
+ *     libballistics_saveGrid: 0, or -1 if the file could not be written
+ *                             or the grid uses a drag curve, whose number
+ *                             would mean nothing to another process
+ *     libballistics_loadGrid: Pointer to the grid, or NULL if the file
+ *                             could not be read or is not a grid
+ */
+
+int libballistics_saveGrid(ballistics_grid_t grid, const char *path);
+ballistics_grid_t libballistics_loadGrid(const char *path);
+
+/* ballistics_card: One solved shot as stored in a card file
+ * Elements:
+ *           shot: Inputs the trajectory was solved from, zero angle
+ *                 included. Cards are found by this shot.
+ *      zeroRange: Range the zero angle was found for (yards), or zero
+ *     yIntercept: Height at zeroRange (inches)
+ *        context: Context holding the shot's trajectory table, as left by
+ *                 libballistics_computeTrajectory or
+ *                 libballistics_cacheTrajectory without a sampled output
+ */
+
+typedef struct ballistics_card {
+    struct ballistics_shot shot;
+    double zeroRange;
+    double yIntercept;
+    ballistics_ctx_t context;
+} *ballistics_card_t;
+
+typedef struct ballistics_cards *ballistics_cards_t;
+
+/* libballistics_writeCards: Writes solved shots to a card file. The file
+ *     holds each card's inputs, zero and full trajectory table, laid out
+ *     to be used in place once mapped, and a hash index of the inputs.
+ *     Files are written in the machine's byte order.
+ * Arguments:
+ *      path: File name
+ *     cards: Cards to write
+ *     count: Number of cards
+ * Returns:
+ *     0, or -1 if a card has no table, uses a drag curve (whose number
+ *     would mean nothing to another process), was solved with air varied
+ *     along the flight (libballistics_setAtmosphere), or the file could
+ *     not be written
+ */
+
+int libballistics_writeCards(const char *path,
+    const struct ballistics_card *cards, unsigned long count);
+
+/* libballistics_openCards: Maps a card file written by
+ *     libballistics_writeCards. Files of the other byte order, an older
+ *     version, or that are damaged are refused.
+ * libballistics_closeCards: Unmaps a card file. No context may still view
+ *     one of its cards.
+ * libballistics_countCards: Number of cards in a file
+ * Arguments:
+ *     path: File name
+ *    cards: The card file
+ * Returns:
+ *     libballistics_openCards: Pointer to the card file, or NULL
+ */
+
+ballistics_cards_t libballistics_openCards(const char *path);
+void libballistics_closeCards(ballistics_cards_t cards);
+unsigned long libballistics_countCards(ballistics_cards_t cards);
+
+/* libballistics_findCard: Finds the card solved from a shot through the
+ *     file's index, comparing every input as the solution cache does. Of
+ *     cards written for the same shot, the first is found.
+ * Arguments:
+ *    cards: The card file
+ *     shot: Shot to look for
+ * Returns:
+ *     Number of the card, or -1 if the file has none for the shot
+ */
+
+long libballistics_findCard(ballistics_cards_t cards,
+    const struct ballistics_shot *shot);
+
+/* libballistics_viewCard: Points a context at a card's trajectory table in
+ *     the mapped file, without copying it, so the libballistics_get*
+ *     functions read the card. The context's own table is freed as by
+ *     libballistics_setTrajectoryBuffer. The file is mapped read only and
+ *     the view never writes the card's rows, which other contexts may be
+ *     viewing: solving into the context again gives it a table of its
+ *     own, as libballistics_setTrajectoryBuffer(context, NULL, 0) does,
+ *     and libballistics_setWind first copies the rows into one.
+ * Arguments:
+ *      cards: The card file
+ *      index: Number of the card
+ *    context: Context that views the card
+ *       card: Receives the card's inputs and zero, or NULL. The shot's
+ *             coefficient arrays point into the file.
+ * Returns:
+ *     Number of rows in the card's table, or -1 for an invalid or
+ *     damaged card
+ */
+
+int libballistics_viewCard(ballistics_cards_t cards, unsigned long index,
+    ballistics_ctx_t context, ballistics_card_t card);
+
 /* Data retrieval functions: Returns individual values for any valid range 
  *     specified.
  * Arguments:
@@ -283,6 +1667,63 @@ double libballistics_getVy (ballistics_ctx_t context, int range);
 int libballistics_getMinPBR(ballistics_ctx_t context, int zeroRange, double vitalZoneRadius);
 int libballistics_getMaxPBR(ballistics_ctx_t context, int zeroRange, double vitalZoneRadius);
 
+
+/* libballistics_getColumn: Copies one column of the trajectory table for
+ *     'count' ranges starting at 'first' and 'step' yards apart. Stops at
+ *     the end of the valid table.
+ * Arguments:
+ *    context: Solutions context
+ *     column: BallisticColumn to copy
+ *      first: First range (yards)
+ *       step: Yards between values (0 means 1)
+ *      count: Number of values wanted
+ *     values: Receives up to count values
+ * Returns:
+ *     Number of values copied, or -1 for an unknown column
+ */
+
+int libballistics_getColumn(ballistics_ctx_t context, int column,
+    unsigned long first, unsigned long step, unsigned long count,
+    double *values);
+
+/* libballistics_getOutput: Fills a sampled, column-per-array output (see
+ *     ballistics_output) from the trajectory table. Ranges beyond the
+ *     valid table are skipped.
+ * Arguments:
+ *    context: Solutions context
+ *     output: Output to fill
+ * Returns:
+ *     Number of samples written, or -1 if the output is invalid or too
+ *     small for the sampling it asks for
+ */
+
+int libballistics_getOutput(ballistics_ctx_t context,
+    ballistics_output_t output);
+
+/* libballistics_getRangeAt: Range at which a column of the trajectory
+ *     table reaches a value, found by binary search over the rows and
+ *     interpolated between the two around it. Works for the columns that
+ *     change monotonically: ColumnTime, which rises, and ColumnVelocity,
+ *     which falls (for all but steep downhill shots). ColumnPathY is
+ *     searched from the apex on, where the path falls.
+ * libballistics_getRangeAtEnergy: Range at which the energy falls to a
+ *     value, as libballistics_computeEnergy reckons it
+ * Arguments:
+ *          context: Solutions context
+ *           column: ColumnTime, ColumnVelocity or ColumnPathY
+ *            value: Value to find, in the column's units
+ *           energy: Energy to find (foot-pounds)
+ *     bulletWeight: Bullet weight (grains)
+ * Returns:
+ *     Range (yards), or -1 if the table never reaches the value or the
+ *     column is not one of the above
+ */
+
+double libballistics_getRangeAt(ballistics_ctx_t context, int column,
+    double value);
+double libballistics_getRangeAtEnergy(ballistics_ctx_t context,
+    double energy, double bulletWeight);
+
 double libballistics_computeEnergy (double velocity, double bulletWeight);
 
 #endif /* __LIBBALLISTICS_H_ */
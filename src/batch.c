@@ -0,0 +1,515 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+#include "ballistics.h"
+#include "internal.h"
+#include <string.h>
+
+/* Batch trajectory calculations */
+
+/* batch_job: Shared state for one call to libballistics_computeTrajectoryBatch.
+ *     Kernels pull shots from it until every shot has been handed out. */
+
+struct batch_job {
+    const struct ballistics_batch *batch;
+    trajectory_path_t paths;        /* One of these two is used */
+    trajectory_pathf_t pathsf;
+    int *rows;
+    unsigned long rowsPerShot;
+    unsigned long next;
+};
+
+/* Solve shot i through libballistics_computeTrajectory in 'context' and
+ * store its table */
+
+static void batch_solveShot(
+    struct batch_job *job,
+    ballistics_ctx_t context,
+    unsigned long i)
+{
+    const struct ballistics_batch *batch = job->batch;
+    trajectory_pathf_t row;
+    trajectory_path_t from;
+    unsigned long b;
+    int n, k;
+
+    job->rows[i] = 0;
+    if (context == NULL)
+        return;
+    libballistics_reset(context);
+    for (b = batch->bcIndex[i]; b < batch->bcIndex[i + 1]; b++)
+        libballistics_addBallisticCoefficient(context, batch->bC[b],
+            batch->minFPS[b], batch->maxFPS[b]);
+    n = libballistics_computeTrajectory(context, batch->dragFunction[i],
+        batch->velocity[i], batch->sightHeight[i], batch->losAngle[i],
+        batch->zeroAngle[i], batch->windVelocity[i], batch->windAngle[i],
+        job->rowsPerShot - 1);
+    if (n < 0)
+        return;
+    if (job->paths) {
+        memcpy(job->paths + i * job->rowsPerShot, context->trajectory,
+            sizeof(struct trajectory_path) * n);
+    } else {
+        row = job->pathsf + i * job->rowsPerShot;
+        for (k = 0, from = context->trajectory; k < n; k++, from++) {
+            row[k].range = (float) from->range;
+            row[k].pathY = (float) from->pathY;
+            row[k].pathX = (float) from->pathX;
+            row[k].elevation = (float) from->elevation;
+            row[k].windage = (float) from->windage;
+            row[k].time = (float) from->time;
+            row[k].velocity = (float) from->velocity;
+            row[k].velocityX = (float) from->velocityX;
+            row[k].velocityY = (float) from->velocityY;
+        }
+    }
+    job->rows[i] = n;
+}
+
+#if defined(__GNUC__)
+
+/* batch_lane: Scalar per-lane state. Everything that changes on every step
+ *     lives in the kernels' vector registers instead. */
+
+struct batch_lane {
+    unsigned long shot;
+    trajectory_path_t path;
+    trajectory_pathf_t pathf;
+    unsigned long n;
+    double velocity;
+    double crosswind;
+    double lastBc;
+    const double *bC;
+    const double *minFPS;
+    const double *maxFPS;
+    unsigned long bands;
+    const struct retardation_segment *segments;
+    int segmentCount;
+};
+
+/* batch_start: Initial integration state of a shot */
+
+struct batch_start {
+    double vx, vy, y;
+    double headwind;
+    double Gx, Gy;
+};
+
+/* Hand the next shot of the job to a lane. Returns 0 once every shot has
+ * been handed out. */
+
+static int batch_nextShot(
+    struct batch_job *job,
+    struct batch_lane *lane,
+    struct batch_start *start)
+{
+    const struct ballistics_batch *batch = job->batch;
+    unsigned long i;
+    double angle;
+
+    /* Shots with drag curves are left to batch_solveCurves */
+    while (job->next < batch->count
+        && libballistics_dragCurve(batch->dragFunction[job->next]))
+        job->next++;
+    if (job->next >= batch->count)
+        return 0;
+    i = job->next++;
+
+    lane->shot = i;
+    if (job->paths)
+        lane->path = job->paths + i * job->rowsPerShot;
+    else
+        lane->pathf = job->pathsf + i * job->rowsPerShot;
+    lane->n = 0;
+    lane->velocity = batch->velocity[i];
+    lane->crosswind = libballistics_crossWind(batch->windVelocity[i],
+        batch->windAngle[i]);
+    lane->lastBc = 0.0;
+    lane->bC = batch->bC + batch->bcIndex[i];
+    lane->minFPS = batch->minFPS + batch->bcIndex[i];
+    lane->maxFPS = batch->maxFPS + batch->bcIndex[i];
+    lane->bands = batch->bcIndex[i + 1] - batch->bcIndex[i];
+    lane->segments = libballistics_retardationSegments(
+        batch->dragFunction[i], &lane->segmentCount);
+
+    angle = libballistics_deg2rad(batch->losAngle[i] + batch->zeroAngle[i]);
+    start->Gy = LIBBALLISTICS_GRAVITY * cos(angle);
+    start->Gx = LIBBALLISTICS_GRAVITY * sin(angle);
+    start->headwind = libballistics_headWind(batch->windVelocity[i],
+        batch->windAngle[i]);
+    start->vx = lane->velocity * cos(libballistics_deg2rad(batch->zeroAngle[i]));
+    start->vy = lane->velocity * sin(libballistics_deg2rad(batch->zeroAngle[i]));
+    start->y = -batch->sightHeight[i] / 12;
+    return 1;
+}
+
+/* Select the BC for a velocity, with the same band rules and fallbacks as
+ * libballistics_computeTrajectory. The open interval (lo, hi) around the
+ * velocity over which the selection cannot change is stored so the kernels
+ * only come back here when the velocity leaves it. Returns 0.0 when the
+ * shot has no usable BC. */
+
+static double batch_selectBc(
+    struct batch_lane *lane,
+    double velocity,
+    double *lo,
+    double *hi)
+{
+    double best = 0.0, lowestBc = 0.0;
+    int lowestVelocity = -1, catchAll = 0;
+    int minFPS, maxFPS;
+    unsigned long i;
+
+    *lo = -HUGE_VAL;
+    *hi = HUGE_VAL;
+    for (i = 0; i < lane->bands && !catchAll; i++) {
+        minFPS = lane->minFPS[i];
+        maxFPS = lane->maxFPS[i];
+        if (minFPS == 0 && maxFPS == 0) {
+            best = lane->bC[i];
+            catchAll = 1;
+        } else if (   (velocity >= minFPS || minFPS == 0)
+                   && (velocity <= maxFPS || maxFPS == 0)  )
+        {
+            if (lowestVelocity == -1 || minFPS < lowestVelocity) {
+                lowestVelocity = minFPS;
+                best = lane->bC[i];
+            }
+        }
+    }
+
+    /* Band edges are the only places the selection can change */
+    for (i = 0; i < lane->bands && !catchAll; i++) {
+        minFPS = lane->minFPS[i];
+        maxFPS = lane->maxFPS[i];
+        if (minFPS != 0) {
+            if (minFPS < velocity && minFPS > *lo) *lo = minFPS;
+            if (minFPS > velocity && minFPS < *hi) *hi = minFPS;
+            if (minFPS == velocity) *lo = *hi = velocity;
+        }
+        if (maxFPS != 0) {
+            if (maxFPS < velocity && maxFPS > *lo) *lo = maxFPS;
+            if (maxFPS > velocity && maxFPS < *hi) *hi = maxFPS;
+            if (maxFPS == velocity) *lo = *hi = velocity;
+        }
+    }
+
+    if (best != 0.0) {
+        lane->lastBc = best;
+        return best;
+    }
+    if (lane->lastBc != 0.0)
+        return lane->lastBc;
+
+    lowestVelocity = -1;
+    for (i = 0; i < lane->bands; i++) {
+        minFPS = lane->minFPS[i];
+        if (lowestVelocity == -1 || minFPS < lowestVelocity) {
+            lowestVelocity = minFPS;
+            lowestBc = lane->bC[i];
+        }
+    }
+    return lowestBc;
+}
+
+/* Select the drag function segment for a velocity. The interval (lo, hi]
+ * over which the segment applies is stored alongside. Returns 0 when the
+ * drag function is undefined at this velocity, in which case the
+ * retardation is -1, as in libballistics_computeRetardation. */
+
+static int batch_selectSegment(
+    const struct batch_lane *lane,
+    double velocity,
+    double *A,
+    double *M,
+    double *lo,
+    double *hi)
+{
+    const struct retardation_segment *segments = lane->segments;
+    int i;
+
+    *A = *M = 0.0;
+    if (lane->segmentCount == 0) {
+        *lo = -HUGE_VAL;
+        *hi = HUGE_VAL;
+        return 0;
+    }
+    for (i = 0; i < lane->segmentCount; i++) {
+        if (velocity > segments[i].velocity)
+            break;
+    }
+    if (i == lane->segmentCount) {
+        *lo = -HUGE_VAL;
+        *hi = segments[i - 1].velocity;
+        return 0;
+    }
+    if (i == 0 && velocity >= LIBBALLISTICS_MAX_VELOCITY) {
+        *lo = nextafter(LIBBALLISTICS_MAX_VELOCITY, 0);
+        *hi = HUGE_VAL;
+        return 0;
+    }
+
+    *A = segments[i].A;
+    *M = segments[i].M;
+    *lo = segments[i].velocity;
+    *hi = (i == 0) ? nextafter(LIBBALLISTICS_MAX_VELOCITY, 0)
+                   : segments[i - 1].velocity;
+    return 1;
+}
+
+/* Store a row of a lane's table. Returns nonzero once the table is full. */
+
+static int batch_record(
+    struct batch_job *job,
+    struct batch_lane *lane,
+    double x, double y, double t,
+    double v, double vx, double vy)
+{
+    trajectory_path_t traj = lane->path + lane->n;
+
+    traj->range = x / 3;
+    traj->pathY = y * 12;
+    traj->pathX = libballistics_computeWindage(lane->crosswind,
+        lane->velocity, x, t);
+    traj->elevation = libballistics_rad2moa(atan(y/x));
+    traj->windage = libballistics_computeWindage(lane->crosswind,
+        lane->velocity, x, t) * 95.5 / (x / 3);
+    traj->time = t;
+    traj->velocity = v;
+    traj->velocityX = vx;
+    traj->velocityY = vy;
+    lane->n++;
+    return lane->n >= job->rowsPerShot;
+}
+
+/* batch_record for the single precision kernels. The row is worked out in
+ * double from the compensated sums and rounded once. */
+
+static int batch_recordFloat(
+    struct batch_job *job,
+    struct batch_lane *lane,
+    double x, double y, double t,
+    double v, double vx, double vy)
+{
+    trajectory_pathf_t traj = lane->pathf + lane->n;
+    double windage = libballistics_computeWindage(lane->crosswind,
+        lane->velocity, x, t);
+
+    traj->range = (float) (x / 3);
+    traj->pathY = (float) (y * 12);
+    traj->pathX = (float) windage;
+    traj->elevation = (float) libballistics_rad2moa(atan(y/x));
+    traj->windage = (float) (windage * 95.5 / (x / 3));
+    traj->time = (float) t;
+    traj->velocity = (float) v;
+    traj->velocityX = (float) vx;
+    traj->velocityY = (float) vy;
+    lane->n++;
+    return lane->n >= job->rowsPerShot;
+}
+
+static void batch_finish(struct batch_job *job, struct batch_lane *lane) {
+    job->rows[lane->shot] = lane->n;
+}
+
+/* The kernels only know the built-in drag functions' power law segments.
+ * Shots with drag curves go through the scalar solver, which evaluates the
+ * curve's spline at the same cost as a built-in model. */
+
+static void batch_solveCurves(struct batch_job *job) {
+    const struct ballistics_batch *batch = job->batch;
+    ballistics_ctx_t context = NULL;
+    unsigned long i;
+
+    for (i = 0; i < batch->count; i++) {
+        if (!libballistics_dragCurve(batch->dragFunction[i]))
+            continue;
+        if (context == NULL)
+            context = libballistics_create();
+        batch_solveShot(job, context, i);
+    }
+    if (context)
+        libballistics_finish(context);
+}
+
+/* SIMD kernels. batch_kernel.h is a template: each inclusion instantiates
+ * batch_run_<isa>() for one instruction set, vector width and precision.
+ * The single precision kernels have twice the lanes of the double ones.
+ * There are generic kernels everywhere and SSE2, AVX2 and AVX-512 ones
+ * on x86; libballistics_simdLevel picks among them. */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+/* Generic vectors are kept to the width x86's baseline passes in
+ * registers */
+#define BATCH_ISA       generic
+#define BATCH_LANES     2
+#include "batch_kernel.h"
+
+#define BATCH_ISA       generic_float
+#define BATCH_LANES     4
+#define BATCH_FLOAT
+#include "batch_kernel.h"
+
+#define BATCH_ISA       sse2
+#define BATCH_TARGET    "sse2"
+#define BATCH_LANES     2
+#include "batch_kernel.h"
+
+#define BATCH_ISA       avx2
+#define BATCH_TARGET    "avx2,fma"
+#define BATCH_LANES     4
+#include "batch_kernel.h"
+
+#define BATCH_ISA       avx512
+#define BATCH_TARGET    "avx512f"
+#define BATCH_LANES     8
+#include "batch_kernel.h"
+
+#define BATCH_ISA       sse2_float
+#define BATCH_TARGET    "sse2"
+#define BATCH_LANES     4
+#define BATCH_FLOAT
+#include "batch_kernel.h"
+
+#define BATCH_ISA       avx2_float
+#define BATCH_TARGET    "avx2,fma"
+#define BATCH_LANES     8
+#define BATCH_FLOAT
+#include "batch_kernel.h"
+
+#define BATCH_ISA       avx512_float
+#define BATCH_TARGET    "avx512f"
+#define BATCH_LANES     16
+#define BATCH_FLOAT
+#include "batch_kernel.h"
+
+static void (*batch_select(void))(struct batch_job *) {
+    switch (libballistics_simdLevel()) {
+        case SimdAVX512: return batch_run_avx512;
+        case SimdAVX2:   return batch_run_avx2;
+        case SimdSSE2:   return batch_run_sse2;
+        default:         return batch_run_generic;
+    }
+}
+
+static void (*batch_selectFloat(void))(struct batch_job *) {
+    switch (libballistics_simdLevel()) {
+        case SimdAVX512: return batch_run_avx512_float;
+        case SimdAVX2:   return batch_run_avx2_float;
+        case SimdSSE2:   return batch_run_sse2_float;
+        default:         return batch_run_generic_float;
+    }
+}
+
+#else
+
+#define BATCH_ISA       generic
+#define BATCH_LANES     4
+#include "batch_kernel.h"
+
+#define BATCH_ISA       generic_float
+#define BATCH_LANES     8
+#define BATCH_FLOAT
+#include "batch_kernel.h"
+
+static void (*batch_select(void))(struct batch_job *) {
+    return batch_run_generic;
+}
+
+static void (*batch_selectFloat(void))(struct batch_job *) {
+    return batch_run_generic_float;
+}
+
+#endif
+
+#else /* !__GNUC__ */
+
+/* Without vector extensions, solve one shot at a time through the
+ * scalar solver. */
+
+static void batch_run_scalar(struct batch_job *job) {
+    ballistics_ctx_t context = libballistics_create();
+    unsigned long i;
+
+    for (i = 0; i < job->batch->count; i++)
+        batch_solveShot(job, context, i);
+    libballistics_finish(context);
+}
+
+#define batch_solveCurves(job)  ((void) 0)
+
+static void (*batch_select(void))(struct batch_job *) {
+    return batch_run_scalar;
+}
+
+static void (*batch_selectFloat(void))(struct batch_job *) {
+    return batch_run_scalar;
+}
+
+#endif /* __GNUC__ */
+
+int libballistics_computeTrajectoryBatch(
+    const struct ballistics_batch *batch,
+    unsigned long maxRange,
+    trajectory_path_t paths,
+    int *rows)
+{
+    void (*kernel)(struct batch_job *) = batch_select();
+    struct batch_job job;
+
+    if (batch == NULL || paths == NULL || rows == NULL)
+        return -1;
+
+    job.batch = batch;
+    job.paths = paths;
+    job.pathsf = NULL;
+    job.rows = rows;
+    job.rowsPerShot = maxRange + 1;
+    job.next = 0;
+    kernel(&job);
+    batch_solveCurves(&job);
+    return 0;
+}
+
+int libballistics_computeTrajectoryBatchFloat(
+    const struct ballistics_batch *batch,
+    unsigned long maxRange,
+    trajectory_pathf_t paths,
+    int *rows)
+{
+    void (*kernel)(struct batch_job *) = batch_selectFloat();
+    struct batch_job job;
+
+    if (batch == NULL || paths == NULL || rows == NULL)
+        return -1;
+
+    job.batch = batch;
+    job.paths = NULL;
+    job.pathsf = paths;
+    job.rows = rows;
+    job.rowsPerShot = maxRange + 1;
+    job.next = 0;
+    kernel(&job);
+    batch_solveCurves(&job);
+    return 0;
+}
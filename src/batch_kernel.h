@@ -0,0 +1,412 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Batch trajectory kernel template, included by batch.c once per
+ * instruction set and precision. The includer defines:
+ *
+ *     BATCH_ISA      suffix for the generated names (sse2, avx2, ...)
+ *     BATCH_TARGET   target attribute string; omit for a generic build
+ *     BATCH_LANES    number of values per vector
+ *     BATCH_FLOAT    defined for the single precision kernel, which writes
+ *                    trajectory_pathf rows
+ *
+ * The step is libballistics_computeTrajectory's, applied to BATCH_LANES
+ * shots at once. Work that only happens every few hundred steps (BC band
+ * and drag segment changes, recording a row, terminating a shot) drops out
+ * to the scalar helpers in batch.c for just the lanes that need it.
+ *
+ * In single precision, time, position and velocity are each carried as a
+ * float sum and a compensation term (Kahan summation). Their increments are a few
+ * thousand times smaller than the sums, so plain float sums would lose
+ * most of each increment's digits; compensated, the sums are good to about
+ * twice float precision while every vector stays float. Rows are recorded
+ * from the compensated sums in double. */
+
+#define BATCH_PASTE_(name, isa)  name##_##isa
+#define BATCH_PASTE(name, isa)   BATCH_PASTE_(name, isa)
+#define BATCH_FN(name)           BATCH_PASTE(name, BATCH_ISA)
+
+#ifdef BATCH_TARGET
+#define BATCH_INLINE static inline \
+    __attribute__((always_inline, target(BATCH_TARGET)))
+#define BATCH_KERNEL static __attribute__((target(BATCH_TARGET)))
+#else
+#define BATCH_INLINE static inline __attribute__((always_inline))
+#define BATCH_KERNEL static
+#endif
+
+#ifdef BATCH_FLOAT
+#define BATCH_REAL      float
+#define BATCH_INT       int
+#else
+#define BATCH_REAL      double
+#define BATCH_INT       long long
+#endif
+
+typedef BATCH_REAL BATCH_FN(vreal)
+    __attribute__((vector_size(BATCH_LANES * sizeof(BATCH_REAL))));
+typedef BATCH_INT BATCH_FN(vmask)
+    __attribute__((vector_size(BATCH_LANES * sizeof(BATCH_REAL))));
+
+#define vreal   BATCH_FN(vreal)
+#define vmask   BATCH_FN(vmask)
+
+BATCH_INLINE vreal BATCH_FN(vsplat)(BATCH_REAL a) {
+    vreal r = { 0 };
+    return r + a;
+}
+
+BATCH_INLINE vreal BATCH_FN(vselect)(vmask m, vreal a, vreal b) {
+    return (vreal)(((vmask)a & m) | ((vmask)b & ~m));
+}
+
+BATCH_INLINE int BATCH_FN(vany)(vmask m) {
+#if !defined(BATCH_TARGET)
+    int i;
+    for (i = 0; i < BATCH_LANES; i++)
+        if (m[i])
+            return 1;
+    return 0;
+#elif defined(BATCH_FLOAT) && BATCH_LANES == 4
+    return _mm_movemask_ps((__m128)m);
+#elif defined(BATCH_FLOAT) && BATCH_LANES == 8
+    return _mm256_movemask_ps((__m256)m);
+#elif defined(BATCH_FLOAT)
+    return _mm512_test_epi32_mask((__m512i)m, (__m512i)m);
+#elif BATCH_LANES == 2
+    return _mm_movemask_pd((__m128d)m);
+#elif BATCH_LANES == 4
+    return _mm256_movemask_pd((__m256d)m);
+#else
+    return _mm512_test_epi64_mask((__m512i)m, (__m512i)m);
+#endif
+}
+
+BATCH_INLINE vreal BATCH_FN(vsqrt)(vreal a) {
+#if !defined(BATCH_TARGET)
+    int i;
+    for (i = 0; i < BATCH_LANES; i++)
+        a[i] = sqrt(a[i]);
+    return a;
+#elif defined(BATCH_FLOAT) && BATCH_LANES == 4
+    return (vreal)_mm_sqrt_ps((__m128)a);
+#elif defined(BATCH_FLOAT) && BATCH_LANES == 8
+    return (vreal)_mm256_sqrt_ps((__m256)a);
+#elif defined(BATCH_FLOAT)
+    return (vreal)_mm512_sqrt_ps((__m512)a);
+#elif BATCH_LANES == 2
+    return (vreal)_mm_sqrt_pd((__m128d)a);
+#elif BATCH_LANES == 4
+    return (vreal)_mm256_sqrt_pd((__m256d)a);
+#else
+    return (vreal)_mm512_sqrt_pd((__m512d)a);
+#endif
+}
+
+#ifdef BATCH_FLOAT
+
+BATCH_INLINE vreal BATCH_FN(vabs)(vreal a) {
+    return (vreal)((vmask)a & 0x7fffffff);
+}
+
+/* Single precision logarithm and exponential, as the double ones below
+ * with the series cut where float precision runs out */
+
+BATCH_INLINE vreal BATCH_FN(vlog)(vreal a) {
+    const float ln2Hi = 6.9314575195e-01f;
+    const float ln2Lo = 1.4286067653e-06f;
+    const float two23 = 8388608.0f;
+    vmask bits = (vmask)a;
+    vmask big;
+    vreal e, m, f, s, p;
+
+    e = (vreal)(((bits >> 23) & 0xff) | 0x4b000000);
+    e = e - (two23 + 127.0f);
+    m = (vreal)((bits & 0x007fffff) | 0x3f800000);
+    big = m > BATCH_FN(vsplat)((float) M_SQRT2);
+    m = BATCH_FN(vselect)(big, m * 0.5f, m);
+    e = BATCH_FN(vselect)(big, e + 1.0f, e);
+
+    f = (m - 1.0f) / (m + 1.0f);
+    s = f * f;
+    p = BATCH_FN(vsplat)(1.0f / 11);
+    p = p * s + 1.0f / 9;
+    p = p * s + 1.0f / 7;
+    p = p * s + 1.0f / 5;
+    p = p * s + 1.0f / 3;
+    p = p * s;
+    return e * ln2Hi + ((2 * f + 2 * f * p) + e * ln2Lo);
+}
+
+BATCH_INLINE vreal BATCH_FN(vexp)(vreal a) {
+    const float ln2Hi = 6.9314575195e-01f;
+    const float ln2Lo = 1.4286067653e-06f;
+    const float shift = 12582912.0f; /* 1.5 * 2^23 */
+    vreal k, n, r, p;
+    vmask scale;
+
+    k = a * (float) M_LOG2E + shift;
+    n = k - shift;
+    r = (a - n * ln2Hi) - n * ln2Lo;
+
+    p = BATCH_FN(vsplat)(1.0f / 40320);
+    p = p * r + 1.0f / 5040;
+    p = p * r + 1.0f / 720;
+    p = p * r + 1.0f / 120;
+    p = p * r + 1.0f / 24;
+    p = p * r + 1.0f / 6;
+    p = p * r + 0.5f;
+    p = p * r + 1.0f;
+    p = p * r + 1.0f;
+
+    scale = ((vmask)k - (vmask)BATCH_FN(vsplat)(shift) + 127) << 23;
+    return p * (vreal)scale;
+}
+
+/* sum += inc, with the rounding error carried in comp */
+#define BATCH_ADD(sum, comp, inc) do { \
+        vreal add_ = (inc) - comp, sum_ = sum + add_; \
+        comp = (sum_ - sum) - add_; \
+        sum = sum_; \
+    } while (0)
+#define BATCH_VALUE(sum, comp, i)   ((double) sum[i] - (double) comp[i])
+#define BATCH_RECORD                batch_recordFloat
+
+#else
+
+BATCH_INLINE vreal BATCH_FN(vabs)(vreal a) {
+    return (vreal)((vmask)a & 0x7fffffffffffffffLL);
+}
+
+/* Natural logarithm of positive, normal arguments. The mantissa is reduced
+ * to [sqrt(1/2), sqrt(2)) and log(m) = 2 atanh((m - 1) / (m + 1)) summed as
+ * a series; the largest term left out is below 1e-17. */
+
+BATCH_INLINE vreal BATCH_FN(vlog)(vreal a) {
+    const double ln2Hi = 6.93147180369123816490e-01;
+    const double ln2Lo = 1.90821492927058770002e-10;
+    const double two52 = 4503599627370496.0;
+    vmask bits = (vmask)a;
+    vmask big;
+    vreal e, m, f, s, p;
+
+    e = (vreal)(((bits >> 52) & 0x7ff) | 0x4330000000000000LL);
+    e = e - (two52 + 1023.0);
+    m = (vreal)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+    big = m > BATCH_FN(vsplat)(M_SQRT2);
+    m = BATCH_FN(vselect)(big, m * 0.5, m);
+    e = BATCH_FN(vselect)(big, e + 1.0, e);
+
+    f = (m - 1.0) / (m + 1.0);
+    s = f * f;
+    p = BATCH_FN(vsplat)(1.0 / 21);
+    p = p * s + 1.0 / 19;
+    p = p * s + 1.0 / 17;
+    p = p * s + 1.0 / 15;
+    p = p * s + 1.0 / 13;
+    p = p * s + 1.0 / 11;
+    p = p * s + 1.0 / 9;
+    p = p * s + 1.0 / 7;
+    p = p * s + 1.0 / 5;
+    p = p * s + 1.0 / 3;
+    p = p * s;
+    return e * ln2Hi + ((2 * f + 2 * f * p) + e * ln2Lo);
+}
+
+/* Exponential for arguments well inside (-700, 700): exp(a) = 2^n exp(r)
+ * with |r| <= ln(2) / 2 and exp(r) from its Taylor series to r^13. */
+
+BATCH_INLINE vreal BATCH_FN(vexp)(vreal a) {
+    const double ln2Hi = 6.93147180369123816490e-01;
+    const double ln2Lo = 1.90821492927058770002e-10;
+    const double shift = 6755399441055744.0; /* 1.5 * 2^52 */
+    vreal k, n, r, p;
+    vmask scale;
+
+    k = a * M_LOG2E + shift;
+    n = k - shift;
+    r = (a - n * ln2Hi) - n * ln2Lo;
+
+    p = BATCH_FN(vsplat)(1.0 / 6227020800.0);
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    scale = ((vmask)k - (vmask)BATCH_FN(vsplat)(shift) + 1023) << 52;
+    return p * (vreal)scale;
+}
+
+#define BATCH_ADD(sum, comp, inc)   (sum = sum + (inc))
+#define BATCH_VALUE(sum, comp, i)   (sum[i])
+#define BATCH_RECORD                batch_record
+
+#endif /* BATCH_FLOAT */
+
+BATCH_KERNEL void BATCH_FN(batch_run)(struct batch_job *job) {
+    struct batch_lane lanes[BATCH_LANES];
+    struct batch_start start;
+    vreal vx, vy, vx1, vy1, x, y, t, v, vp, dt, dv, dvx, dvy;
+    vreal headwind, Gx, Gy, bC, A, M, bcLo, bcHi, segLo, segHi, nextRow;
+    vmask live, bad, refresh, record, done;
+#ifdef BATCH_FLOAT
+    vreal xc, yc, tc, vxc, vyc;
+#endif
+    double lo, hi, a, m;
+    int i, alive = 0, more = 1;
+
+    vx = BATCH_FN(vsplat)(1.0);
+    vy = x = y = t = headwind = Gx = Gy = BATCH_FN(vsplat)(0.0);
+    bC = A = M = bcLo = bcHi = segLo = segHi = nextRow = vy;
+    live = bad = (vmask)vy;
+#ifdef BATCH_FLOAT
+    xc = yc = tc = vxc = vyc = vy;
+#endif
+
+    for (;;) {
+        /* Hand idle lanes the next shots in the batch */
+        for (i = 0; more && alive < BATCH_LANES && i < BATCH_LANES; i++) {
+            if (live[i])
+                continue;
+            if (!batch_nextShot(job, &lanes[i], &start)) {
+                more = 0;
+                break;
+            }
+            vx[i] = start.vx;
+            vy[i] = start.vy;
+            x[i] = 0;
+            y[i] = start.y;
+            t[i] = 0;
+#ifdef BATCH_FLOAT
+            xc[i] = yc[i] = tc[i] = vxc[i] = vyc[i] = 0;
+#endif
+            headwind[i] = start.headwind;
+            Gx[i] = start.Gx;
+            Gy[i] = start.Gy;
+            bcLo[i] = bcHi[i] = segLo[i] = segHi[i] = 0;
+            nextRow[i] = 0;
+            live[i] = -1;
+            alive++;
+        }
+        if (alive == 0)
+            break;
+
+        vx1 = vx, vy1 = vy;
+        v = BATCH_FN(vsqrt)(vx * vx + vy * vy);
+        dt = 0.5 / v;
+        vp = v + headwind;
+
+        /* Variable BCs and drag segments only need selecting again once
+         * the velocity leaves the interval the last selection covers */
+        refresh = live & ~((v > bcLo) & (v < bcHi) & (vp > segLo)
+            & (vp <= segHi));
+        if (BATCH_FN(vany)(refresh)) {
+            for (i = 0; i < BATCH_LANES; i++) {
+                if (!refresh[i])
+                    continue;
+                bC[i] = batch_selectBc(&lanes[i], v[i], &lo, &hi);
+                bcLo[i] = lo;
+                bcHi[i] = hi;
+                if (bC[i] == 0.0) {
+                    batch_finish(job, &lanes[i]);
+                    live[i] = 0;
+                    alive--;
+                    continue;
+                }
+                bad[i] = batch_selectSegment(&lanes[i], vp[i], &a, &m,
+                    &lo, &hi) ? 0 : -1;
+                A[i] = a;
+                M[i] = m;
+                segLo[i] = lo;
+                segHi[i] = hi;
+            }
+        }
+
+        /* Compute acceleration using the drag function retardation */
+        dv = A * BATCH_FN(vexp)(M * BATCH_FN(vlog)(vp)) / bC;
+        dv = BATCH_FN(vselect)(bad, BATCH_FN(vsplat)(-1.0), dv);
+        dvx = -(vx / v) * dv;
+        dvy = -(vy / v) * dv;
+
+        /* Compute velocity, including resolved gravity vectors */
+        BATCH_ADD(vx, vxc, dt * dvx);
+        BATCH_ADD(vx, vxc, dt * Gx);
+        BATCH_ADD(vy, vyc, dt * dvy);
+        BATCH_ADD(vy, vyc, dt * Gy);
+
+        record = live & (x / 3 >= nextRow);
+        if (BATCH_FN(vany)(record)) {
+            for (i = 0; i < BATCH_LANES; i++) {
+                if (!record[i])
+                    continue;
+                if (BATCH_RECORD(job, &lanes[i], BATCH_VALUE(x, xc, i),
+                        BATCH_VALUE(y, yc, i), BATCH_VALUE(t, tc, i) + dt[i],
+                        v[i], BATCH_VALUE(vx, vxc, i),
+                        BATCH_VALUE(vy, vyc, i))) {
+                    batch_finish(job, &lanes[i]);
+                    live[i] = 0;
+                    alive--;
+                    continue;
+                }
+                nextRow[i] = lanes[i].n;
+            }
+        }
+
+        /* Compute position based on average velocity */
+        BATCH_ADD(x, xc, dt * (vx + vx1) / 2);
+        BATCH_ADD(y, yc, dt * (vy + vy1) / 2);
+
+        done = live & ((BATCH_FN(vabs)(vy) > BATCH_FN(vabs)(3 * vx))
+            | (v <= 0.0) | (x <= 0.0) | (v != v));
+        if (BATCH_FN(vany)(done)) {
+            for (i = 0; i < BATCH_LANES; i++) {
+                if (!done[i])
+                    continue;
+                batch_finish(job, &lanes[i]);
+                live[i] = 0;
+                alive--;
+            }
+        }
+        BATCH_ADD(t, tc, dt);
+    }
+}
+
+#undef vreal
+#undef vmask
+#undef BATCH_REAL
+#undef BATCH_INT
+#undef BATCH_ADD
+#undef BATCH_VALUE
+#undef BATCH_RECORD
+#undef BATCH_FLOAT
+#undef BATCH_INLINE
+#undef BATCH_KERNEL
+#undef BATCH_ISA
+#undef BATCH_TARGET
+#undef BATCH_LANES
@@ -0,0 +1,1679 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Benchmark suite for the solver hot paths.
+ *
+ * Usage: bench [-n shots] [-r maxRange] [-o results.csv] [-c baseline.csv]
+ *              [suite ...]
+ *
+ * Suites, all run by default:
+ *     retardation  libballistics_computeRetardation and the cursor form,
+ *                  ns/call for each drag model
+ *     drag         libballistics_dragForModel and dragForModelArray,
+ *                  ns/call for each drag model
+ *     zero         libballistics_computeZeroAngle and solveZeroAngle,
+ *                  us/call for each drag model at several zero ranges
+ *     trajectory   libballistics_computeTrajectory across drag models,
+ *                  ranges, velocities, BC band counts and integrators:
+ *                  trajectories/sec, steps/sec and ns/step
+ *     batch        'shots' random shots (default 20000) out to 'maxRange'
+ *                  yards (default 1000) through the scalar solver and
+ *                  libballistics_computeTrajectoryBatch
+ *     integrators  Accuracy against speed for the fixed step and adaptive
+ *                  integrators on up to 1000 of those shots, against an
+ *                  adaptive reference at a 1e-12 tolerance. The error is
+ *                  the largest pathY difference (inches), with the
+ *                  reference interpolated at each row's range
+ *     sweep        libballistics_computeSweep over a fixed 720 point grid
+ *                  with 1, 2, 4, ... threads up to the processor count
+ *     cache        Zero and trajectory requests for 32 loads at random
+ *                  ranges, solved directly and through the solution cache
+ *     sensitivity  One solve with libballistics_setSensitivities against
+ *                  the ten solves of central differences for its five
+ *                  parameters, G1 and G7 with both integrators
+ *     montecarlo   libballistics_computeHitProbability at 300 and 1000
+ *                  yards: samples/sec on one thread and on every
+ *                  processor, and the samples needed to stop at a +/-1%
+ *                  confidence interval
+ *     grid         libballistics_createGrid, loadGrid and queryGrid on a
+ *                  16 x 22 node grid of G1 and G7 out to 1000 yards
+ *     cards        libballistics_writeCards and openCards for 1000 G7
+ *                  cards out to 1000 yards, and findCard plus viewCard
+ *                  on random cards
+ *     stream       A 3000 yard G7 solve into a table, streamed to a
+ *                  callback, and streamed with the callback stopping at
+ *                  120 inches of drop, with both integrators
+ *     pbr          libballistics_solveMaxPBR for a 4 inch zone against a
+ *                  search over zero ranges a yard apart with
+ *                  libballistics_getMaxPBR
+ *     events       A 2000 yard G7 solve with and without
+ *                  libballistics_setEvents, and getRangeAt against a scan
+ *                  of the velocity column
+ *     float        Up to 1000 of the batch suite's shots out to 2000 yards
+ *                  through libballistics_computeTrajectoryBatch and
+ *                  computeTrajectoryBatchFloat: trajectories/sec for each,
+ *                  and the largest pathY, pathX and time differences for
+ *                  each drag model
+ *     simd         libballistics_dragForModelArray and both batch solvers
+ *                  on up to 5000 of the batch suite's shots at each
+ *                  libballistics_setSimdLevel level the processor supports,
+ *                  and the elements of a dense sweep where the array
+ *                  differs from libballistics_dragForModel (should be 0)
+ *     curves       The G7 model against a drag curve sampled from its
+ *                  table: retardation, drag and zero angle per call and
+ *                  a 1000 yard solve with both integrators
+ *     atmosphere   A 1000 yard G7 solve from a 5000 foot station at 30
+ *                  degrees up, flat and down, with the coefficient
+ *                  corrected at the muzzle and with the air varied by
+ *                  libballistics_setAtmosphere: ns/step and the change
+ *                  in pathY at 1000 yards
+ *
+ * Inputs are fixed (random shots come from a seeded LCG) and every timing
+ * is the best of several runs, so results can be compared between builds.
+ * -o writes each result as a CSV line "suite,case,metric,value"; -c reads
+ * such a file and shows each result's change against it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ballistics.h"
+
+#define COUNTOF(a) (sizeof(a) / sizeof((a)[0]))
+
+static const int models[] = { G1, G2, G5, G6, G7, G8 };
+static const char *modelNames[] = { "", "G1", "G2", "G3", "G4", "G5", "G6",
+    "G7", "G8" };
+
+struct shots {
+    struct ballistics_batch batch;
+    int *dragFunction;
+    double *velocity, *sightHeight, *losAngle, *zeroAngle;
+    double *windVelocity, *windAngle;
+    unsigned long *bcIndex;
+    double *bC, *minFPS, *maxFPS;
+};
+
+static unsigned long seed = 12345;
+
+/* Uniform random number in [lo, hi); a fixed LCG keeps runs comparable */
+static double uniform(double lo, double hi) {
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return lo + (hi - lo) * ((seed >> 11) / 9007199254740992.0);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void generateShots(struct shots *s, unsigned long count) {
+    unsigned long i, b = 0;
+    double bc;
+
+    s->dragFunction = calloc(count, sizeof(int));
+    s->velocity = calloc(count, sizeof(double));
+    s->sightHeight = calloc(count, sizeof(double));
+    s->losAngle = calloc(count, sizeof(double));
+    s->zeroAngle = calloc(count, sizeof(double));
+    s->windVelocity = calloc(count, sizeof(double));
+    s->windAngle = calloc(count, sizeof(double));
+    s->bcIndex = calloc(count + 1, sizeof(unsigned long));
+    s->bC = calloc(count * 3, sizeof(double));
+    s->minFPS = calloc(count * 3, sizeof(double));
+    s->maxFPS = calloc(count * 3, sizeof(double));
+
+    for (i = 0; i < count; i++) {
+        s->dragFunction[i] = models[i % 6];
+        s->velocity[i] = uniform(1800, 3600);
+        s->sightHeight[i] = 1.5;
+        s->losAngle[i] = uniform(-10, 10);
+        s->zeroAngle[i] = uniform(0.02, 0.3);
+        s->windVelocity[i] = uniform(0, 20);
+        s->windAngle[i] = uniform(0, 360);
+        bc = uniform(0.2, 0.7);
+        s->bcIndex[i] = b;
+        if (i % 4 == 3) {
+            /* Sierra-style stepped BCs */
+            s->bC[b] = bc;        s->minFPS[b] = 2800; s->maxFPS[b++] = 0;
+            s->bC[b] = bc * 0.95; s->minFPS[b] = 1800; s->maxFPS[b++] = 2800;
+            s->bC[b] = bc * 0.9;  s->minFPS[b] = 0;    s->maxFPS[b++] = 1800;
+        } else {
+            s->bC[b] = bc;        s->minFPS[b] = 0;    s->maxFPS[b++] = 0;
+        }
+    }
+    s->bcIndex[count] = b;
+
+    s->batch.count = count;
+    s->batch.dragFunction = s->dragFunction;
+    s->batch.velocity = s->velocity;
+    s->batch.sightHeight = s->sightHeight;
+    s->batch.losAngle = s->losAngle;
+    s->batch.zeroAngle = s->zeroAngle;
+    s->batch.windVelocity = s->windVelocity;
+    s->batch.windAngle = s->windAngle;
+    s->batch.bcIndex = s->bcIndex;
+    s->batch.bC = s->bC;
+    s->batch.minFPS = s->minFPS;
+    s->batch.maxFPS = s->maxFPS;
+}
+
+/* Results */
+
+struct result {
+    char key[128];
+    double value;
+};
+
+static FILE *csv;
+static struct result *baseline;
+static int baselineCount;
+
+static void loadBaseline(const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[256], *comma;
+    int size = 0;
+
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), file)) {
+        comma = strrchr(line, ',');
+        if (comma == NULL || comma - line >= (int) sizeof(baseline->key))
+            continue;
+        if (baselineCount == size) {
+            size = size ? size * 2 : 256;
+            baseline = realloc(baseline, size * sizeof(struct result));
+            if (baseline == NULL) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+        }
+        *comma = 0;
+        strcpy(baseline[baselineCount].key, line);
+        baseline[baselineCount++].value = strtod(comma + 1, NULL);
+    }
+    fclose(file);
+}
+
+static void report(const char *suite, const char *name, const char *metric,
+    double value)
+{
+    char key[128];
+    int i;
+
+    snprintf(key, sizeof(key), "%s,%s,%s", suite, name, metric);
+    printf("%-12s %-30s %12.4g %s", suite, name, value, metric);
+    for (i = 0; i < baselineCount; i++) {
+        if (strcmp(baseline[i].key, key) == 0) {
+            if (baseline[i].value != 0)
+                printf(" (%+.1f%%)", 100 * (value / baseline[i].value - 1));
+            break;
+        }
+    }
+    printf("\n");
+    if (csv)
+        fprintf(csv, "%s,%.9g\n", key, value);
+}
+
+/* Timing. 'fn' makes 'calls' calls of whatever is measured; timeCalls finds
+ * a call count that runs for at least 20ms and returns the best time per
+ * call (seconds) of five runs. */
+
+typedef void (*bench_fn)(void *arg, unsigned long calls);
+
+static double timeCalls(bench_fn fn, void *arg) {
+    unsigned long calls = 1;
+    double t, best;
+    int run;
+
+    for (;;) {
+        t = now();
+        fn(arg, calls);
+        t = now() - t;
+        if (t >= 0.02)
+            break;
+        calls *= t < 0.002 ? 10 : 2;
+    }
+    best = t;
+    for (run = 1; run < 5; run++) {
+        t = now();
+        fn(arg, calls);
+        t = now() - t;
+        if (t < best)
+            best = t;
+    }
+    return best / calls;
+}
+
+/* Keeps results live so the measured calls are not optimized away */
+static volatile double sink;
+
+/* retardation and drag suites */
+
+#define SAMPLES 1024
+
+struct call_args {
+    int model;
+    double velocity[SAMPLES];
+    double temperature[SAMPLES];
+    double cd[SAMPLES];
+};
+
+static void callRetardation(void *arg, unsigned long calls) {
+    struct call_args *a = arg;
+    double sum = 0;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        sum += libballistics_computeRetardation(a->model, 0.5,
+            a->velocity[i & (SAMPLES - 1)]);
+    sink = sum;
+}
+
+/* The cursor is meant for slowly falling velocities, as on a trajectory,
+ * so it is measured on a descending sweep */
+static void callCursorRetardation(void *arg, unsigned long calls) {
+    struct call_args *a = arg;
+    struct retardation_cursor cursor;
+    double sum = 0;
+    unsigned long i;
+
+    libballistics_initRetardationCursor(&cursor, a->model);
+    for (i = 0; i < calls; i++)
+        sum += libballistics_computeCursorRetardation(&cursor, 0.5,
+            3900 - 3800.0 * (i & (SAMPLES - 1)) / SAMPLES);
+    sink = sum;
+}
+
+static void callDrag(void *arg, unsigned long calls) {
+    struct call_args *a = arg;
+    double sum = 0;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        sum += libballistics_dragForModel(a->model,
+            a->velocity[i & (SAMPLES - 1)], a->temperature[i & (SAMPLES - 1)]);
+    sink = sum;
+}
+
+static void callDragArray(void *arg, unsigned long calls) {
+    struct call_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        libballistics_dragForModelArray(a->model, a->velocity,
+            a->temperature, a->cd, SAMPLES);
+    sink = a->cd[0];
+}
+
+static void fillSamples(struct call_args *a) {
+    int i;
+
+    for (i = 0; i < SAMPLES; i++) {
+        a->velocity[i] = uniform(100, 4000);
+        a->temperature[i] = uniform(0, 100);
+    }
+}
+
+static void benchRetardation(void) {
+    struct call_args a;
+    unsigned int m;
+
+    fillSamples(&a);
+    for (m = 0; m < COUNTOF(models); m++) {
+        a.model = models[m];
+        report("retardation", modelNames[a.model], "ns/call",
+            timeCalls(callRetardation, &a) * 1e9);
+        report("retardation", modelNames[a.model], "cursor ns/call",
+            timeCalls(callCursorRetardation, &a) * 1e9);
+    }
+}
+
+static void benchDrag(void) {
+    struct call_args a;
+    unsigned int m;
+
+    fillSamples(&a);
+    for (m = 0; m < COUNTOF(models); m++) {
+        a.model = models[m];
+        report("drag", modelNames[a.model], "ns/call",
+            timeCalls(callDrag, &a) * 1e9);
+        report("drag", modelNames[a.model], "array ns/element",
+            timeCalls(callDragArray, &a) * 1e9 / SAMPLES);
+    }
+}
+
+/* zero suite */
+
+struct zero_args {
+    int model;
+    double zeroRange;
+};
+
+static void callZero(void *arg, unsigned long calls) {
+    struct zero_args *a = arg;
+    double sum = 0;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        sum += libballistics_computeZeroAngle(a->model, 0.45, 2800, 1.5,
+            a->zeroRange, 0);
+    sink = sum;
+}
+
+static void callSolveZero(void *arg, unsigned long calls) {
+    struct zero_args *a = arg;
+    struct zero_solution solution;
+    double sum = 0;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++) {
+        libballistics_solveZeroAngle(a->model, 0.45, 2800, 1.5, a->zeroRange,
+            0, &solution);
+        sum += solution.angle;
+    }
+    sink = sum;
+}
+
+static void benchZero(void) {
+    static const double ranges[] = { 100, 300, 600 };
+    struct zero_args a;
+    char name[64];
+    unsigned int m, r;
+
+    for (m = 0; m < COUNTOF(models); m++) {
+        for (r = 0; r < COUNTOF(ranges); r++) {
+            a.model = models[m];
+            a.zeroRange = ranges[r];
+            snprintf(name, sizeof(name), "%s/%.0fyd", modelNames[a.model],
+                a.zeroRange);
+            report("zero", name, "us/call", timeCalls(callZero, &a) * 1e6);
+            report("zero", name, "solve us/call",
+                timeCalls(callSolveZero, &a) * 1e6);
+        }
+    }
+}
+
+/* trajectory suite */
+
+struct trajectory_args {
+    ballistics_ctx_t context;
+    int model;
+    double velocity;
+    unsigned long maxRange;
+};
+
+static void callTrajectory(void *arg, unsigned long calls) {
+    struct trajectory_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        libballistics_computeTrajectory(a->context, a->model, a->velocity,
+            1.5, 0, 0.1, 10, 90, a->maxRange);
+}
+
+/* Times one trajectory case. 'bands' BCs split 0-4000 fps evenly, the
+ * lowest and highest open ended, as with published stepped BCs. */
+static void trajectoryCase(int model, double velocity, unsigned long maxRange,
+    int bands, int integrator)
+{
+    struct trajectory_args a;
+    char name[64];
+    double t;
+    int b;
+
+    a.context = libballistics_create();
+    a.model = model;
+    a.velocity = velocity;
+    a.maxRange = maxRange;
+    libballistics_setIntegrator(a.context, integrator, 0);
+    for (b = 0; b < bands; b++)
+        libballistics_addBallisticCoefficient(a.context,
+            0.45 * (0.9 + 0.1 * b / bands),
+            b == 0 ? 0 : 4000 * b / bands,
+            b == bands - 1 ? 0 : 4000 * (b + 1) / bands);
+
+    t = timeCalls(callTrajectory, &a);
+    snprintf(name, sizeof(name), "%s/%luyd/%.0ffps/%dbc%s", modelNames[model],
+        maxRange, velocity, bands,
+        integrator == AdaptiveIntegrator ? "/adaptive" : "");
+    report("trajectory", name, "trajectories/sec", 1 / t);
+    report("trajectory", name, "steps/sec", a.context->steps / t);
+    report("trajectory", name, "ns/step", t * 1e9 / a.context->steps);
+    libballistics_finish(a.context);
+}
+
+static void benchTrajectory(void) {
+    static const unsigned long ranges[] = { 100, 500, 1000, 2000 };
+    static const double velocities[] = { 1200, 2000, 3600 };
+    static const int bands[] = { 3, 6 };
+    unsigned int m, i;
+
+    for (m = 0; m < COUNTOF(models); m++)
+        for (i = 0; i < COUNTOF(ranges); i++)
+            trajectoryCase(models[m], 2800, ranges[i], 1, EulerIntegrator);
+    for (i = 0; i < COUNTOF(velocities); i++)
+        trajectoryCase(G1, velocities[i], 1000, 1, EulerIntegrator);
+    for (i = 0; i < COUNTOF(bands); i++) {
+        trajectoryCase(G1, 2800, 1000, bands[i], EulerIntegrator);
+        trajectoryCase(G7, 2800, 1000, bands[i], EulerIntegrator);
+    }
+    for (m = 0; m < COUNTOF(models); m++)
+        trajectoryCase(models[m], 2800, 1000, 1, AdaptiveIntegrator);
+}
+
+/* batch and integrators suites */
+
+/* Difference between two table entries: relative for magnitudes above 1,
+ * absolute below */
+static double deviation(double a, double b) {
+    double scale = fabs(b) > 1 ? fabs(b) : 1;
+    if (a != a && b != b)
+        return 0;
+    if (a == b)
+        return 0;
+    return fabs(a - b) / scale;
+}
+
+/* Solves shots [0, count) with libballistics_computeTrajectory, storing
+ * the tables at 'paths' and row counts at 'rows'. Returns elapsed seconds.
+ */
+static double solveScalar(struct shots *s, unsigned long count,
+    unsigned long maxRange, int integrator, double tolerance,
+    trajectory_path_t paths, int *rows)
+{
+    ballistics_ctx_t context = libballistics_create();
+    unsigned long i, b;
+    double start = now();
+
+    libballistics_setIntegrator(context, integrator, tolerance);
+    for (i = 0; i < count; i++) {
+        libballistics_reset(context);
+        for (b = s->bcIndex[i]; b < s->bcIndex[i + 1]; b++)
+            libballistics_addBallisticCoefficient(context, s->bC[b],
+                s->minFPS[b], s->maxFPS[b]);
+        rows[i] = libballistics_computeTrajectory(context,
+            s->dragFunction[i], s->velocity[i], s->sightHeight[i],
+            s->losAngle[i], s->zeroAngle[i], s->windVelocity[i],
+            s->windAngle[i], maxRange);
+        if (rows[i] < 0)
+            rows[i] = 0;
+        memcpy(paths + i * (maxRange + 1), context->trajectory,
+            sizeof(struct trajectory_path) * rows[i]);
+    }
+    libballistics_finish(context);
+    return now() - start;
+}
+
+/* Largest pathY difference between tables and the reference tables, with
+ * the reference interpolated linearly to each row's range */
+static double pathError(unsigned long count, unsigned long maxRange,
+    trajectory_path_t paths, int *rows, trajectory_path_t ref, int *refRows)
+{
+    unsigned long i;
+    int r, k;
+    double worst = 0, f, y;
+
+    for (i = 0; i < count; i++) {
+        trajectory_path_t p = paths + i * (maxRange + 1);
+        trajectory_path_t q = ref + i * (maxRange + 1);
+        for (r = 1; r < rows[i]; r++) {
+            k = (int) p[r].range;
+            if (k + 1 >= refRows[i])
+                break;
+            f = (p[r].range - q[k].range) / (q[k + 1].range - q[k].range);
+            y = q[k].pathY + f * (q[k + 1].pathY - q[k].pathY);
+            if (fabs(p[r].pathY - y) > worst)
+                worst = fabs(p[r].pathY - y);
+        }
+    }
+    return worst;
+}
+
+static void benchBatch(struct shots *s, unsigned long count,
+    unsigned long maxRange)
+{
+    unsigned long rowsPerShot = maxRange + 1;
+    trajectory_path_t scalar, batch;
+    int *scalarRows, *batchRows;
+    unsigned long i, mismatched = 0;
+    int r;
+    double start, scalarTime, batchTime, worst = 0;
+    char name[64];
+
+    scalar = calloc(count * rowsPerShot, sizeof(struct trajectory_path));
+    batch = calloc(count * rowsPerShot, sizeof(struct trajectory_path));
+    scalarRows = calloc(count, sizeof(int));
+    batchRows = calloc(count, sizeof(int));
+    if (!scalar || !batch || !scalarRows || !batchRows) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    scalarTime = solveScalar(s, count, maxRange, EulerIntegrator, 0,
+        scalar, scalarRows);
+
+    start = now();
+    libballistics_computeTrajectoryBatch(&s->batch, maxRange, batch,
+        batchRows);
+    batchTime = now() - start;
+
+    for (i = 0; i < count; i++) {
+        if (scalarRows[i] != batchRows[i]) {
+            mismatched++;
+            continue;
+        }
+        for (r = 0; r < scalarRows[i]; r++) {
+            double *a = (double *) (batch + i * rowsPerShot + r);
+            double *e = (double *) (scalar + i * rowsPerShot + r);
+            unsigned int c;
+            for (c = 0; c < sizeof(struct trajectory_path) / sizeof(double);
+                 c++)
+            {
+                if (deviation(a[c], e[c]) > worst)
+                    worst = deviation(a[c], e[c]);
+            }
+        }
+    }
+
+    snprintf(name, sizeof(name), "%lushots/%luyd", count, maxRange);
+    report("batch", name, "scalar traj/sec", count / scalarTime);
+    report("batch", name, "batch traj/sec", count / batchTime);
+    report("batch", name, "speedup", scalarTime / batchTime);
+    report("batch", name, "max deviation", worst);
+    report("batch", name, "row mismatches", mismatched);
+
+    free(scalar);
+    free(batch);
+    free(scalarRows);
+    free(batchRows);
+}
+
+/* float suite */
+
+static void benchFloat(struct shots *s, unsigned long count) {
+    static const unsigned long maxRange = 2000;
+    unsigned long rowsPerShot = maxRange + 1;
+    trajectory_path_t paths, e;
+    trajectory_pathf_t pathsf, a;
+    int *rows, *rowsf;
+    unsigned long i, total = s->batch.count, mismatched = 0;
+    int r, k;
+    double start, doubleTime, floatTime, d, f;
+    double worstY[COUNTOF(modelNames)], worstX[COUNTOF(modelNames)];
+    double worstT[COUNTOF(modelNames)];
+    unsigned int m;
+    char name[64];
+
+    paths = calloc(count * rowsPerShot, sizeof(struct trajectory_path));
+    pathsf = calloc(count * rowsPerShot, sizeof(struct trajectory_pathf));
+    rows = calloc(count, sizeof(int));
+    rowsf = calloc(count, sizeof(int));
+    if (!paths || !pathsf || !rows || !rowsf) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memset(worstY, 0, sizeof(worstY));
+    memset(worstX, 0, sizeof(worstX));
+    memset(worstT, 0, sizeof(worstT));
+
+    s->batch.count = count;
+    start = now();
+    libballistics_computeTrajectoryBatch(&s->batch, maxRange, paths, rows);
+    doubleTime = now() - start;
+    start = now();
+    libballistics_computeTrajectoryBatchFloat(&s->batch, maxRange, pathsf,
+        rowsf);
+    floatTime = now() - start;
+
+    /* Rows are recorded at the first step past each yard, and a step
+     * either side of it is within both solvers' own error. So, as in
+     * pathError, the double table is interpolated to each float row's
+     * range. */
+    for (i = 0; i < count; i++) {
+        m = s->dragFunction[i];
+        if (rows[i] != rowsf[i])
+            mismatched++;
+        for (r = 1; r < rowsf[i]; r++) {
+            a = pathsf + i * rowsPerShot + r;
+            e = paths + i * rowsPerShot;
+            k = (int) a->range;
+            if (k + 1 >= rows[i])
+                break;
+            f = (a->range - e[k].range) / (e[k + 1].range - e[k].range);
+            d = fabs(a->pathY - (e[k].pathY
+                + f * (e[k + 1].pathY - e[k].pathY)));
+            worstY[m] = d > worstY[m] ? d : worstY[m];
+            d = fabs(a->pathX - (e[k].pathX
+                + f * (e[k + 1].pathX - e[k].pathX)));
+            worstX[m] = d > worstX[m] ? d : worstX[m];
+            d = fabs(a->time - (e[k].time + f * (e[k + 1].time - e[k].time)));
+            worstT[m] = d > worstT[m] ? d : worstT[m];
+        }
+    }
+
+    snprintf(name, sizeof(name), "%lushots/%luyd", count, maxRange);
+    report("float", name, "double traj/sec", count / doubleTime);
+    report("float", name, "float traj/sec", count / floatTime);
+    report("float", name, "speedup", doubleTime / floatTime);
+    report("float", name, "row mismatches", mismatched);
+    for (m = 0; m < COUNTOF(models); m++) {
+        snprintf(name, sizeof(name), "%s/%luyd", modelNames[models[m]],
+            maxRange);
+        report("float", name, "max pathY error (in)", worstY[models[m]]);
+        report("float", name, "max pathX error (in)", worstX[models[m]]);
+        report("float", name, "max time error (s)", worstT[models[m]]);
+    }
+
+    s->batch.count = total;
+    free(paths);
+    free(pathsf);
+    free(rows);
+    free(rowsf);
+}
+
+/* simd suite */
+
+/* Elements of a dense velocity and temperature sweep, over every drag
+ * model, where libballistics_dragForModelArray differs in any bit from
+ * libballistics_dragForModel */
+
+static unsigned long dragMismatches(void) {
+    double velocity[SAMPLES], temperature[SAMPLES], cd[SAMPLES], scalar;
+    unsigned long mismatches = 0;
+    unsigned int m, pass;
+    int i;
+
+    for (pass = 0; pass < 64; pass++) {
+        for (i = 0; i < SAMPLES; i++) {
+            velocity[i] = 50 + (pass * SAMPLES + i) * 0.06137;
+            temperature[i] = -20 + (i % 97) * 1.3;
+        }
+        for (m = 0; m < COUNTOF(models); m++) {
+            libballistics_dragForModelArray(models[m], velocity, temperature,
+                cd, SAMPLES);
+            for (i = 0; i < SAMPLES; i++) {
+                scalar = libballistics_dragForModel(models[m], velocity[i],
+                    temperature[i]);
+                mismatches += memcmp(&scalar, cd + i, sizeof(double)) != 0;
+            }
+        }
+    }
+    return mismatches;
+}
+
+static void benchSimd(struct shots *s, unsigned long count,
+    unsigned long maxRange)
+{
+    unsigned long rowsPerShot = maxRange + 1;
+    unsigned long total = s->batch.count;
+    trajectory_path_t paths;
+    trajectory_pathf_t pathsf;
+    struct call_args *a;
+    int *rows, level, best = libballistics_getSimdLevel();
+    double start;
+    const char *name;
+
+    paths = calloc(count * rowsPerShot, sizeof(struct trajectory_path));
+    pathsf = calloc(count * rowsPerShot, sizeof(struct trajectory_pathf));
+    rows = calloc(count, sizeof(int));
+    a = malloc(sizeof(struct call_args));
+    if (!paths || !pathsf || !rows || !a) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    fillSamples(a);
+    a->model = G7;
+    s->batch.count = count;
+
+    /* From the processor's best (or LIBBALLISTICS_SIMD) down */
+    for (level = best; level >= SimdGeneric; level--) {
+        libballistics_setSimdLevel(level);
+        name = libballistics_getSimdName(level);
+        report("simd", name, "G7 drag array ns/element",
+            timeCalls(callDragArray, a) * 1e9 / SAMPLES);
+        report("simd", name, "drag array mismatches", dragMismatches());
+        start = now();
+        libballistics_computeTrajectoryBatch(&s->batch, maxRange, paths,
+            rows);
+        report("simd", name, "batch traj/sec", count / (now() - start));
+        start = now();
+        libballistics_computeTrajectoryBatchFloat(&s->batch, maxRange,
+            pathsf, rows);
+        report("simd", name, "float batch traj/sec",
+            count / (now() - start));
+    }
+    libballistics_setSimdLevel(-1);
+
+    s->batch.count = total;
+    free(paths);
+    free(pathsf);
+    free(rows);
+    free(a);
+}
+
+static void benchIntegrators(struct shots *s, unsigned long count,
+    unsigned long maxRange)
+{
+    static const double tolerances[] = { 1e-4, 1e-6, 1e-8, 1e-10 };
+    unsigned long rowsPerShot = maxRange + 1;
+    trajectory_path_t ref, paths;
+    int *refRows, *rows;
+    double t;
+    char name[64];
+    unsigned int k;
+
+    ref = calloc(count * rowsPerShot, sizeof(struct trajectory_path));
+    paths = calloc(count * rowsPerShot, sizeof(struct trajectory_path));
+    refRows = calloc(count, sizeof(int));
+    rows = calloc(count, sizeof(int));
+    if (!ref || !paths || !refRows || !rows) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    solveScalar(s, count, maxRange, AdaptiveIntegrator, 1e-12, ref, refRows);
+
+    t = solveScalar(s, count, maxRange, EulerIntegrator, 0, paths, rows);
+    report("integrators", "euler", "solves/sec", count / t);
+    report("integrators", "euler", "max pathY error",
+        pathError(count, maxRange, paths, rows, ref, refRows));
+    for (k = 0; k < COUNTOF(tolerances); k++) {
+        t = solveScalar(s, count, maxRange, AdaptiveIntegrator,
+            tolerances[k], paths, rows);
+        snprintf(name, sizeof(name), "adaptive/%.0e", tolerances[k]);
+        report("integrators", name, "solves/sec", count / t);
+        report("integrators", name, "max pathY error",
+            pathError(count, maxRange, paths, rows, ref, refRows));
+    }
+
+    free(ref);
+    free(paths);
+    free(refRows);
+    free(rows);
+}
+
+/* sweep suite */
+
+static void sweepSink(void *arg, const struct ballistics_sweep_job *job,
+    ballistics_ctx_t context, int rows)
+{
+    double *last = arg;
+    last[job->index] = rows > 0 ? context->trajectory[rows - 1].pathY : 0;
+}
+
+static void benchSweep(void) {
+    static const double velocity[] = { 1600, 1900, 2200, 2500, 2800, 3100,
+        3400, 3700 };
+    static const double bC[] = { 0.2, 0.3, 0.4, 0.5, 0.6 };
+    static const double losAngle[] = { -20, 0, 30 };
+    static const double zeroAngle[] = { 0.1 };
+    static const double windVelocity[] = { 0, 15 };
+    static const double windAngle[] = { 90 };
+    static const unsigned long maxRange[] = { 500, 1000, 1500 };
+    struct ballistics_sweep sweep;
+    double *last, *first, t, serial = 0;
+    unsigned long total;
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    char name[64];
+    int threads;
+
+    memset(&sweep, 0, sizeof(sweep));
+    sweep.dragFunction = G1;
+    sweep.sightHeight = 1.5;
+    sweep.velocity = velocity;
+    sweep.velocityCount = COUNTOF(velocity);
+    sweep.bC = bC;
+    sweep.bCCount = COUNTOF(bC);
+    sweep.losAngle = losAngle;
+    sweep.losAngleCount = COUNTOF(losAngle);
+    sweep.zeroAngle = zeroAngle;
+    sweep.zeroAngleCount = COUNTOF(zeroAngle);
+    sweep.windVelocity = windVelocity;
+    sweep.windVelocityCount = COUNTOF(windVelocity);
+    sweep.windAngle = windAngle;
+    sweep.windAngleCount = COUNTOF(windAngle);
+    sweep.maxRange = maxRange;
+    sweep.maxRangeCount = COUNTOF(maxRange);
+    sweep.sink = sweepSink;
+
+    total = sweep.velocityCount * sweep.bCCount * sweep.losAngleCount
+        * sweep.windVelocityCount * sweep.maxRangeCount;
+    last = calloc(total, sizeof(double));
+    first = calloc(total, sizeof(double));
+    if (!last || !first) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (threads = 1; ; threads = threads * 2 < processors ? threads * 2
+        : processors)
+    {
+        sweep.threads = threads;
+        sweep.arg = threads == 1 ? first : last;
+        t = now();
+        libballistics_computeSweep(&sweep);
+        t = now() - t;
+        if (threads == 1)
+            serial = t;
+        snprintf(name, sizeof(name), "%luxG1/%dthreads", total, threads);
+        report("sweep", name, "trajectories/sec", total / t);
+        report("sweep", name, "speedup", serial / t);
+        if (threads > 1 && memcmp(first, last, total * sizeof(double)))
+            fprintf(stderr, "sweep: results with %d threads differ\n",
+                threads);
+        if (threads >= processors)
+            break;
+    }
+
+    free(last);
+    free(first);
+}
+
+/* cache suite */
+
+#define CACHE_LOADS     32
+#define CACHE_REQUESTS  4000
+
+static void benchCache(void) {
+    static double bC[CACHE_LOADS];
+    struct ballistics_shot shots[CACHE_LOADS], *shot;
+    struct ballistics_cache_stats stats;
+    ballistics_cache_t cache;
+    ballistics_ctx_t context;
+    unsigned long range[CACHE_REQUESTS];
+    int load[CACHE_REQUESTS];
+    double direct, cached;
+    int i;
+
+    memset(shots, 0, sizeof(shots));
+    for (i = 0; i < CACHE_LOADS; i++) {
+        bC[i] = uniform(0.2, 0.7);
+        shots[i].dragFunction = models[i % COUNTOF(models)];
+        shots[i].bcCount = 1;
+        shots[i].bC = bC + i;
+        shots[i].velocity = uniform(2200, 3200);
+        shots[i].sightHeight = 1.5;
+        shots[i].windVelocity = 10;
+        shots[i].windAngle = 90;
+    }
+    for (i = 0; i < CACHE_REQUESTS; i++) {
+        load[i] = (int) uniform(0, CACHE_LOADS);
+        range[i] = (unsigned long) uniform(100, 1000);
+    }
+
+    context = libballistics_create();
+    direct = now();
+    for (i = 0; i < CACHE_REQUESTS; i++) {
+        shot = shots + load[i];
+        libballistics_reset(context);
+        libballistics_addBallisticCoefficient(context, shot->bC[0], 0, 0);
+        shot->zeroAngle = libballistics_computeZeroAngle(shot->dragFunction,
+            shot->bC[0], shot->velocity, shot->sightHeight, 100, 0);
+        libballistics_computeTrajectory(context, shot->dragFunction,
+            shot->velocity, shot->sightHeight, 0, shot->zeroAngle,
+            shot->windVelocity, shot->windAngle, range[i]);
+    }
+    direct = now() - direct;
+
+    cache = libballistics_createCache(64 << 20, 0);
+    cached = now();
+    for (i = 0; i < CACHE_REQUESTS; i++) {
+        shot = shots + load[i];
+        shot->zeroAngle = libballistics_cacheZeroAngle(cache, shot, 100, 0);
+        libballistics_cacheTrajectory(cache, shot, context, range[i]);
+    }
+    cached = now() - cached;
+    libballistics_getCacheStats(cache, &stats);
+
+    report("cache", "32loads/random range", "direct requests/sec",
+        CACHE_REQUESTS / direct);
+    report("cache", "32loads/random range", "cached requests/sec",
+        CACHE_REQUESTS / cached);
+    report("cache", "32loads/random range", "hit rate",
+        (double) stats.hits / (stats.hits + stats.misses));
+    report("cache", "32loads/random range", "cache MB", stats.bytes / 1e6);
+    libballistics_finishCache(cache);
+    libballistics_finish(context);
+}
+
+/* sensitivity suite */
+
+#define SENSITIVITY_RANGE   1000
+
+struct sensitivity_args {
+    ballistics_ctx_t context;
+    int model;
+};
+
+static void callSensitivities(void *arg, unsigned long calls) {
+    struct sensitivity_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        libballistics_computeTrajectory(a->context, a->model, 2800, 1.5, 0,
+            0.1, 10, 90, SENSITIVITY_RANGE);
+}
+
+/* The central differences the sensitivities replace: two perturbed solves
+ * for each parameter */
+static void callDifferences(void *arg, unsigned long calls) {
+    struct sensitivity_args *a = arg;
+    double bC = a->context->bCs->bC, d;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++) {
+        for (d = -1; d <= 1; d += 2) {
+            libballistics_computeTrajectory(a->context, a->model, 2800 + d,
+                1.5, 0, 0.1, 10, 90, SENSITIVITY_RANGE);
+            a->context->bCs->bC = bC + d * 1e-3;
+            libballistics_computeTrajectory(a->context, a->model, 2800, 1.5,
+                0, 0.1, 10, 90, SENSITIVITY_RANGE);
+            a->context->bCs->bC = bC;
+            libballistics_computeTrajectory(a->context, a->model, 2800, 1.5,
+                0, 0.1 + d * 1e-2, 10, 90, SENSITIVITY_RANGE);
+            libballistics_computeTrajectory(a->context, a->model, 2800, 1.5,
+                d * 1e-2, 0.1, 10, 90, SENSITIVITY_RANGE);
+            libballistics_computeTrajectory(a->context, a->model, 2800, 1.5,
+                0, 0.1, 10 + d * 0.1, 90, SENSITIVITY_RANGE);
+        }
+    }
+}
+
+static void benchSensitivity(void) {
+    static struct ballistics_sensitivity rows[SENSITIVITY_RANGE + 1];
+    static const int sensitivityModels[] = { G1, G7 };
+    struct sensitivity_args a;
+    char name[64];
+    double single, differences;
+    unsigned int m;
+    int integrator;
+
+    for (m = 0; m < COUNTOF(sensitivityModels); m++) {
+        for (integrator = EulerIntegrator; integrator <= AdaptiveIntegrator;
+            integrator++)
+        {
+            a.context = libballistics_create();
+            a.model = sensitivityModels[m];
+            libballistics_setIntegrator(a.context, integrator, 0);
+            libballistics_addBallisticCoefficient(a.context, 0.45, 0, 0);
+
+            differences = timeCalls(callDifferences, &a);
+            libballistics_setSensitivities(a.context, rows, COUNTOF(rows));
+            single = timeCalls(callSensitivities, &a);
+
+            snprintf(name, sizeof(name), "%s/%dyd%s", modelNames[a.model],
+                SENSITIVITY_RANGE,
+                integrator == AdaptiveIntegrator ? "/adaptive" : "");
+            report("sensitivity", name, "tangent solves/sec", 1 / single);
+            report("sensitivity", name, "difference sets/sec",
+                1 / differences);
+            report("sensitivity", name, "speedup", differences / single);
+            libballistics_finish(a.context);
+        }
+    }
+}
+
+/* montecarlo suite */
+
+static void montecarloCase(double range, int threads, double tolerance,
+    unsigned long samples)
+{
+    static double bC = 0.3;
+    struct ballistics_shot shot;
+    struct ballistics_dispersion d;
+    struct ballistics_hit hit;
+    char name[64];
+    double t;
+
+    memset(&shot, 0, sizeof(shot));
+    shot.dragFunction = G7;
+    shot.bcCount = 1;
+    shot.bC = &bC;
+    shot.velocity = 2800;
+    shot.sightHeight = 1.5;
+    shot.windVelocity = 10;
+    shot.windAngle = 90;
+    shot.zeroAngle = libballistics_computeZeroAngle(G7, bC, 2800, 1.5, 100, 0);
+
+    memset(&d, 0, sizeof(d));
+    d.range = range;
+    d.targetWidth = 18 * range / 1000;
+    d.targetHeight = 30 * range / 1000;
+    d.velocity = 10;
+    d.bC = 0.02;
+    d.windVelocity = 3;
+    d.windAngle = 15;
+    d.rangeError = range / 100;
+    d.precision = 0.5;
+    d.samples = samples;
+    d.tolerance = tolerance;
+    d.seed = 1;
+    d.threads = threads;
+
+    t = now();
+    libballistics_computeHitProbability(&shot, &d, &hit);
+    t = now() - t;
+
+    snprintf(name, sizeof(name), "G7/%.0fyd/%dthreads%s", range, threads,
+        tolerance > 0 ? "/early stop" : "");
+    report("montecarlo", name, "samples/sec", hit.samples / t);
+    report("montecarlo", name, "samples", hit.samples);
+    report("montecarlo", name, "hit probability", hit.probability);
+}
+
+static void benchMontecarlo(void) {
+    static const double ranges[] = { 300, 1000 };
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int i;
+
+    for (i = 0; i < COUNTOF(ranges); i++) {
+        montecarloCase(ranges[i], 1, 0, 4096);
+        if (online > 1)
+            montecarloCase(ranges[i], (int) online, 0, 4096);
+        montecarloCase(ranges[i], online > 0 ? (int) online : 1, 0.01,
+            100000);
+    }
+}
+
+/* grid suite */
+
+#define GRID_QUERIES    4096
+
+struct grid_args {
+    ballistics_grid_t grid;
+    double bC[GRID_QUERIES], velocity[GRID_QUERIES], range[GRID_QUERIES];
+    double error;
+};
+
+static void callGrid(void *arg, unsigned long calls) {
+    struct grid_args *a = arg;
+    struct ballistics_grid_answer answer;
+    unsigned long i, k;
+
+    for (i = 0; i < calls; i++) {
+        k = i % GRID_QUERIES;
+        libballistics_queryGrid(a->grid, G7, a->bC[k], a->velocity[k],
+            a->range[k], 10, &answer);
+        sink += answer.pathY;
+    }
+}
+
+static void benchGrid(void) {
+    static const int gridModels[] = { G1, G7 };
+    static struct grid_args a;
+    struct ballistics_grid_spec spec;
+    struct ballistics_grid_answer answer;
+    const char *path = "bench-grid.tmp";
+    char name[64];
+    double t;
+    int i, p;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.dragFunction = gridModels;
+    spec.dragCount = COUNTOF(gridModels);
+    spec.bCMin = 0.2;
+    spec.bCMax = 0.7;
+    spec.bCCount = 16;
+    spec.velocityMin = 2000;
+    spec.velocityMax = 3400;
+    spec.velocityCount = 22;
+    spec.sightHeight = 1.5;
+    spec.zeroRange = 100;
+    spec.maxRange = 1000;
+    for (i = 0; i < GRID_QUERIES; i++) {
+        a.bC[i] = uniform(0.2, 0.7);
+        a.velocity[i] = uniform(2000, 3400);
+        a.range[i] = uniform(0, 1000);
+    }
+
+    for (p = InterpolateLinear; p <= InterpolateCubic; p++) {
+        spec.interpolation = p;
+        snprintf(name, sizeof(name), "G1+G7/16x22/1000yd/%s",
+            p == InterpolateCubic ? "cubic" : "linear");
+
+        t = now();
+        a.grid = libballistics_createGrid(&spec);
+        t = now() - t;
+        if (a.grid == NULL)
+            return;
+        report("grid", name, "build sec", t);
+
+        libballistics_saveGrid(a.grid, path);
+        libballistics_finishGrid(a.grid);
+        t = now();
+        a.grid = libballistics_loadGrid(path);
+        t = now() - t;
+        remove(path);
+        if (a.grid == NULL)
+            return;
+        report("grid", name, "load ms", t * 1e3);
+
+        t = timeCalls(callGrid, &a);
+        report("grid", name, "ns/query", t * 1e9);
+        for (i = 0, a.error = 0; i < GRID_QUERIES; i++) {
+            libballistics_queryGrid(a.grid, G7, a.bC[i], a.velocity[i],
+                a.range[i], 10, &answer);
+            a.error += answer.pathYError / GRID_QUERIES;
+        }
+        report("grid", name, "mean pathY error estimate", a.error);
+        libballistics_finishGrid(a.grid);
+    }
+}
+
+/* stream suite */
+
+struct stream_args {
+    ballistics_ctx_t context;
+    double floor;
+};
+
+static int streamSample(void *arg, const double *values,
+    unsigned long sample)
+{
+    struct stream_args *a = arg;
+
+    (void) sample;
+    sink += values[ColumnPathY];
+    return a->floor != 0 && values[ColumnPathY] < a->floor;
+}
+
+static void callStream(void *arg, unsigned long calls) {
+    struct stream_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        sink += libballistics_computeTrajectory(a->context, G7, 2800, 1.5, 0,
+            0.05, 10, 90, 3000);
+}
+
+static void benchStream(void) {
+    static const char *modes[] = { "table", "callback", "callback/stop" };
+    struct ballistics_output output;
+    struct stream_args a;
+    char name[64];
+    double t;
+    int integrator, mode;
+
+    for (integrator = EulerIntegrator; integrator <= AdaptiveIntegrator;
+         integrator++) {
+        for (mode = 0; mode < (int) COUNTOF(modes); mode++) {
+            a.context = libballistics_create();
+            if (a.context == NULL)
+                return;
+            libballistics_addBallisticCoefficient(a.context, 0.3, 0, 0);
+            libballistics_setIntegrator(a.context, integrator, 0);
+            a.floor = mode == 2 ? -120 : 0;
+            if (mode > 0) {
+                memset(&output, 0, sizeof(output));
+                output.columns = LIBBALLISTICS_ALL_COLUMNS;
+                output.callback = streamSample;
+                output.arg = &a;
+                libballistics_setOutput(a.context, &output);
+            }
+            snprintf(name, sizeof(name), "G7/3000yd/%s/%s",
+                integrator == AdaptiveIntegrator ? "adaptive" : "euler",
+                modes[mode]);
+            t = timeCalls(callStream, &a);
+            report("stream", name, "us/solve", t * 1e6);
+            libballistics_finish(a.context);
+        }
+    }
+}
+
+/* pbr suite */
+
+struct pbr_args {
+    ballistics_ctx_t context;
+    int dragFunction;
+    struct ballistics_pbr pbr;
+};
+
+static void callPbr(void *arg, unsigned long calls) {
+    struct pbr_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++) {
+        libballistics_solveMaxPBR(a->context, a->dragFunction, 2800, 1.5, 4,
+            &a->pbr);
+        sink += a->pbr.maxRange;
+    }
+}
+
+/* The search solveMaxPBR replaces: zero at every yard, solve, and keep the
+ * longest range whose apex stays in the zone */
+
+static int pbrByZero(ballistics_ctx_t context, int dragFunction) {
+    struct zero_solution zero;
+    int z, i, best = 0, far, high;
+
+    for (z = 50; z <= 400; z++) {
+        if (libballistics_solveZeroAngle(dragFunction, 0.35, 2800, 1.5, z, 0,
+            &zero))
+            continue;
+        libballistics_computeTrajectory(context, dragFunction, 2800, 1.5, 0,
+            zero.angle, 0, 0, 600);
+        for (i = 0, high = 0; i <= z && !high; i++)
+            high = libballistics_getPathY(context, i) > 4;
+        far = libballistics_getMaxPBR(context, z, 4);
+        if (!high && far > best)
+            best = far;
+    }
+    return best;
+}
+
+static void benchPbr(void) {
+    static const int pbrModels[] = { G1, G7 };
+    struct pbr_args a;
+    char name[64];
+    double t;
+    unsigned int m;
+    int far;
+
+    a.context = libballistics_create();
+    if (a.context == NULL)
+        return;
+    libballistics_addBallisticCoefficient(a.context, 0.35, 0, 0);
+    for (m = 0; m < COUNTOF(pbrModels); m++) {
+        a.dragFunction = pbrModels[m];
+        snprintf(name, sizeof(name), "%s/2800fps/4in",
+            pbrModels[m] == G1 ? "G1" : "G7");
+        t = timeCalls(callPbr, &a);
+        report("pbr", name, "us/solve", t * 1e6);
+        report("pbr", name, "max PBR yd", a.pbr.maxRange);
+        report("pbr", name, "flights", a.pbr.iterations);
+
+        t = now();
+        far = pbrByZero(a.context, a.dragFunction);
+        t = now() - t;
+        report("pbr", name, "zero search us", t * 1e6);
+        report("pbr", name, "zero search max PBR yd", far);
+    }
+    libballistics_finish(a.context);
+}
+
+/* events suite */
+
+struct events_args {
+    ballistics_ctx_t context;
+    double angle;
+    double found;
+};
+
+static void callEventSolve(void *arg, unsigned long calls) {
+    struct events_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        sink += libballistics_computeTrajectory(a->context, G7, 2800, 1.5, 0,
+            a->angle, 10, 90, 2000);
+}
+
+static void callRangeAt(void *arg, unsigned long calls) {
+    struct events_args *a = arg;
+    unsigned long i;
+
+    for (i = 0; i < calls; i++)
+        sink += libballistics_getRangeAt(a->context, ColumnVelocity,
+            1000 + (double) (i % 1024));
+}
+
+/* The scan getRangeAt replaces */
+
+static void callRangeScan(void *arg, unsigned long calls) {
+    struct events_args *a = arg;
+    unsigned long i;
+    double value;
+    int n;
+
+    for (i = 0; i < calls; i++) {
+        value = 1000 + (double) (i % 1024);
+        for (n = 0; n <= 2000; n++) {
+            if (libballistics_getVelocity(a->context, n) <= value)
+                break;
+        }
+        sink += n;
+    }
+}
+
+static void benchEvents(void) {
+    struct ballistics_events events;
+    struct events_args a;
+    char name[64];
+    double t;
+    int integrator;
+
+    a.angle = libballistics_computeZeroAngle(G7, 0.3, 2800, 1.5, 200, 0);
+    for (integrator = EulerIntegrator; integrator <= AdaptiveIntegrator;
+         integrator++) {
+        a.context = libballistics_create();
+        if (a.context == NULL)
+            return;
+        libballistics_addBallisticCoefficient(a.context, 0.3, 0, 0);
+        libballistics_setIntegrator(a.context, integrator, 0);
+        snprintf(name, sizeof(name), "G7/2000yd/%s",
+            integrator == AdaptiveIntegrator ? "adaptive" : "euler");
+
+        t = timeCalls(callEventSolve, &a);
+        report("events", name, "us/solve", t * 1e6);
+        memset(&events, 0, sizeof(events));
+        libballistics_setEvents(a.context, &events);
+        t = timeCalls(callEventSolve, &a);
+        report("events", name, "us/solve with events", t * 1e6);
+        report("events", name, "subsonic yd", events.range[EventMach10]);
+
+        t = timeCalls(callRangeAt, &a);
+        report("events", name, "ns/getRangeAt", t * 1e9);
+        t = timeCalls(callRangeScan, &a);
+        report("events", name, "ns/scan", t * 1e9);
+        libballistics_finish(a.context);
+    }
+}
+
+/* cards suite */
+
+#define CARD_COUNT      1000
+
+struct cards_args {
+    ballistics_cards_t file;
+    struct ballistics_card card[CARD_COUNT];
+    double bC[CARD_COUNT];
+    ballistics_ctx_t context;
+};
+
+static void callCards(void *arg, unsigned long calls) {
+    struct cards_args *a = arg;
+    unsigned long i;
+    long k;
+
+    for (i = 0; i < calls; i++) {
+        k = libballistics_findCard(a->file,
+            &a->card[i * 7919 % CARD_COUNT].shot);
+        if (k >= 0 && libballistics_viewCard(a->file, k, a->context, NULL) > 0)
+            sink += libballistics_getPathY(a->context, 500);
+    }
+}
+
+static void benchCards(void) {
+    static struct cards_args a;
+    const char *path = "bench-cards.tmp";
+    struct ballistics_shot *shot;
+    double t;
+    int i, ok = 1;
+
+    for (i = 0; i < CARD_COUNT; i++) {
+        shot = &a.card[i].shot;
+        a.bC[i] = uniform(0.2, 0.7);
+        shot->dragFunction = G7;
+        shot->bcCount = 1;
+        shot->bC = a.bC + i;
+        shot->velocity = uniform(2000, 3400);
+        shot->sightHeight = 1.5;
+        shot->zeroAngle = libballistics_computeZeroAngle(G7, a.bC[i],
+            shot->velocity, 1.5, 100, 0);
+        shot->windVelocity = 10;
+        shot->windAngle = 90;
+        a.card[i].zeroRange = 100;
+        a.card[i].context = libballistics_create();
+        ok = ok && a.card[i].context != NULL
+            && libballistics_addBallisticCoefficient(a.card[i].context,
+                a.bC[i], 0, 0) == 0
+            && libballistics_computeTrajectory(a.card[i].context, G7,
+                shot->velocity, 1.5, 0, shot->zeroAngle, 10, 90, 1000) > 0;
+    }
+
+    if (ok) {
+        t = now();
+        ok = libballistics_writeCards(path, a.card, CARD_COUNT) == 0;
+        t = now() - t;
+        report("cards", "G7/1000 cards/1000yd", "write ms", t * 1e3);
+    }
+    if (ok) {
+        t = now();
+        a.file = libballistics_openCards(path);
+        t = now() - t;
+        ok = a.file != NULL;
+        report("cards", "G7/1000 cards/1000yd", "open us", t * 1e6);
+    }
+    a.context = libballistics_create();
+    if (ok && a.context) {
+        t = timeCalls(callCards, &a);
+        report("cards", "G7/1000 cards/1000yd", "ns/find+view", t * 1e9);
+        libballistics_setTrajectoryBuffer(a.context, NULL, 0);
+    }
+    libballistics_finish(a.context);
+    libballistics_closeCards(a.file);
+    remove(path);
+    for (i = 0; i < CARD_COUNT; i++)
+        libballistics_finish(a.card[i].context);
+}
+
+/* curves suite */
+
+/* A drag curve sampled from the G7 table every 0.05 Mach, about as dense
+ * as a Doppler radar curve, timed against the built-in model */
+
+static void curveCase(int dragFunction, const char *name) {
+    struct call_args c;
+    struct zero_args z;
+    struct trajectory_args t;
+    double elapsed;
+    int integrator;
+
+    fillSamples(&c);
+    c.model = dragFunction;
+    report("curves", name, "retardation ns/call",
+        timeCalls(callRetardation, &c) * 1e9);
+    report("curves", name, "cursor ns/call",
+        timeCalls(callCursorRetardation, &c) * 1e9);
+    report("curves", name, "drag ns/call", timeCalls(callDrag, &c) * 1e9);
+
+    z.model = dragFunction;
+    z.zeroRange = 300;
+    report("curves", name, "zero us/call", timeCalls(callZero, &z) * 1e6);
+
+    t.context = libballistics_create();
+    if (t.context == NULL)
+        return;
+    t.model = dragFunction;
+    t.velocity = 2800;
+    t.maxRange = 1000;
+    libballistics_addBallisticCoefficient(t.context, 0.45, 0, 0);
+    for (integrator = EulerIntegrator; integrator <= AdaptiveIntegrator;
+        integrator++) {
+        libballistics_setIntegrator(t.context, integrator, 0);
+        elapsed = timeCalls(callTrajectory, &t);
+        if (integrator == EulerIntegrator) {
+            report("curves", name, "1000yd ns/step",
+                elapsed * 1e9 / t.context->steps);
+            report("curves", name, "1000yd us/solve", elapsed * 1e6);
+        } else
+            report("curves", name, "1000yd adaptive us/solve", elapsed * 1e6);
+    }
+    libballistics_finish(t.context);
+}
+
+static void benchCurves(void) {
+    double mach[101], cd[101];
+    int i, curve;
+
+    for (i = 0; i < 101; i++) {
+        mach[i] = 0.05 * i;
+        cd[i] = libballistics_dragForModel(G7,
+            mach[i] * LIBBALLISTICS_SPEED_OF_SOUND, 59);
+    }
+    curve = libballistics_addDragCurve(mach, cd, 101);
+    if (curve < 0)
+        return;
+    curveCase(G7, "G7");
+    curveCase(curve, "G7 curve/101pt");
+}
+
+/* atmosphere suite */
+
+/* A 1000 yard G7 solve from a 5000 foot station, the coefficient corrected
+ * once at the muzzle against the air varied along the flight, on the flat
+ * and 30 degrees up and down */
+
+static void benchAtmosphere(void) {
+    static const double angles[] = { -30, 0, 30 };
+    struct trajectory_args a;
+    char name[64];
+    double bC, t, muzzle, drop;
+    unsigned int i;
+    int varying;
+
+    a.context = libballistics_create();
+    if (a.context == NULL)
+        return;
+    a.model = G7;
+    a.velocity = 2800;
+    a.maxRange = 1000;
+    bC = libballistics_applyAtmosphere(0.45, 5000, 24.9, 41, 0.5);
+    for (i = 0; i < COUNTOF(angles); i++) {
+        for (varying = 0; varying <= 1; varying++) {
+            libballistics_reset(a.context);
+            libballistics_addBallisticCoefficient(a.context,
+                varying ? 0.45 : bC, 0, 0);
+            libballistics_setAtmosphere(a.context,
+                varying ? AtmosphereStandard : AtmosphereNone, 5000, 24.9,
+                41, 0.5);
+            t = timeCalls(callTrajectory, &a);
+            libballistics_computeTrajectory(a.context, G7, 2800, 1.5,
+                angles[i], 0.1, 0, 0, 1000);
+            drop = libballistics_getPathY(a.context, 1000);
+            if (!varying)
+                muzzle = drop;
+            snprintf(name, sizeof(name), "G7/1000yd/%+.0fdeg/%s", angles[i],
+                varying ? "varying" : "muzzle");
+            report("atmosphere", name, "ns/step",
+                t * 1e9 / a.context->steps);
+            if (varying)
+                report("atmosphere", name, "pathY change in", drop - muzzle);
+        }
+    }
+    libballistics_finish(a.context);
+}
+
+static const char *suites[] = { "retardation", "drag", "zero", "trajectory",
+    "batch", "integrators", "sweep", "cache", "sensitivity", "montecarlo",
+    "grid", "cards", "stream", "pbr", "events", "float", "simd",
+    "curves", "atmosphere" };
+
+static void usage(void) {
+    unsigned int i;
+
+    fprintf(stderr, "usage: bench [-n shots] [-r maxRange] [-o results.csv] "
+        "[-c baseline.csv] [suite ...]\nsuites:");
+    for (i = 0; i < COUNTOF(suites); i++)
+        fprintf(stderr, " %s", suites[i]);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long count = 20000, maxRange = 1000;
+    int selected[COUNTOF(suites)];
+    int any = 0, i;
+    unsigned int k;
+    struct shots s;
+
+    memset(selected, 0, sizeof(selected));
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            if (argv[i][1] == 0 || argv[i][2] != 0 || i + 1 >= argc)
+                usage();
+            switch (argv[i][1]) {
+                case 'n': count = strtoul(argv[++i], NULL, 10); break;
+                case 'r': maxRange = strtoul(argv[++i], NULL, 10); break;
+                case 'c': loadBaseline(argv[++i]); break;
+                case 'o':
+                    csv = fopen(argv[++i], "w");
+                    if (csv == NULL) {
+                        perror(argv[i]);
+                        return 1;
+                    }
+                    break;
+                default: usage();
+            }
+            continue;
+        }
+        for (k = 0; k < COUNTOF(suites); k++) {
+            if (strcmp(argv[i], suites[k]) == 0)
+                break;
+        }
+        if (k == COUNTOF(suites))
+            usage();
+        selected[k] = 1;
+        any = 1;
+    }
+    if (count == 0 || maxRange == 0)
+        usage();
+
+    if (!any || selected[0])
+        benchRetardation();
+    if (!any || selected[1])
+        benchDrag();
+    if (!any || selected[2])
+        benchZero();
+    if (!any || selected[3])
+        benchTrajectory();
+    if (!any || selected[4] || selected[5] || selected[15] || selected[16]) {
+        generateShots(&s, count);
+        if (!any || selected[4])
+            benchBatch(&s, count, maxRange);
+        if (!any || selected[5])
+            benchIntegrators(&s, count < 1000 ? count : 1000, maxRange);
+        if (!any || selected[15])
+            benchFloat(&s, count < 1000 ? count : 1000);
+        if (!any || selected[16])
+            benchSimd(&s, count < 5000 ? count : 5000, maxRange);
+    }
+    if (!any || selected[6])
+        benchSweep();
+    if (!any || selected[7])
+        benchCache();
+    if (!any || selected[8])
+        benchSensitivity();
+    if (!any || selected[9])
+        benchMontecarlo();
+    if (!any || selected[10])
+        benchGrid();
+    if (!any || selected[11])
+        benchCards();
+    if (!any || selected[12])
+        benchStream();
+    if (!any || selected[13])
+        benchPbr();
+    if (!any || selected[14])
+        benchEvents();
+    if (!any || selected[17])
+        benchCurves();
+    if (!any || selected[18])
+        benchAtmosphere();
+
+    if (csv)
+        fclose(csv);
+    return 0;
+}
@@ -0,0 +1,611 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Solution cache.
+ *
+ * A shot is reduced to a canonical key: the words of every input that can
+ * change its solution, in a fixed order, with band limits truncated as the
+ * context stores them and negative zeros folded into positive ones. The
+ * key's hash picks a shard and a bucket within it. Each shard has its own
+ * lock, hash table and CLOCK ring, and a fixed share of the size limit.
+ *
+ * Lookups copy the solution out under the shard lock, and feed sampled
+ * outputs from that copy once it is released. Misses are solved with the
+ * lock released, so two threads missing on the same shot may both solve
+ * it; the first to finish stores its solution and the other's is dropped. */
+
+#include <pthread.h>
+#include <string.h>
+#include "internal.h"
+
+#define DEFAULT_SHARDS      16
+#define MAX_SHARDS          1024
+#define INITIAL_BUCKETS     64
+
+struct cache_entry {
+    struct cache_entry *hashNext;
+    struct cache_entry *clockNext, *clockPrev;
+    unsigned long long hash;
+    int referenced;
+    unsigned long keyLength;
+    double *key;
+    unsigned long bytes;
+    double angle;                   /* CacheZero */
+    unsigned long maxRange;         /* CacheTrajectory */
+    unsigned long maxValidRange;
+    int rows;
+    struct trajectory_path *table;
+};
+
+struct cache_shard {
+    pthread_mutex_t lock;
+    struct cache_entry **buckets;
+    unsigned long bucketCount;
+    struct cache_entry *hand;
+    unsigned long limit;
+    struct ballistics_cache_stats stats;
+};
+
+struct ballistics_cache {
+    struct cache_shard *shards;
+    int shardCount;
+};
+
+/* Key */
+
+static double canonical(double x) {
+    return x == 0.0 ? 0.0 : x;
+}
+
+/* Number of key words for a shot */
+
+unsigned long libballistics_shotKeyLength(const struct ballistics_shot *shot,
+    int kind)
+{
+    return SHOT_KEY_HEADER + (kind == CacheZero ? 1 : 3 * shot->bcCount);
+}
+
+/* Writes the key of a shot to 'key'. Zero angles only depend on the
+ * projectile, sight and atmosphere, and use the first coefficient alone;
+ * 'zeroRange' and 'yIntercept' only apply to them. */
+
+void libballistics_shotKey(const struct ballistics_shot *shot, int kind,
+    double zeroRange, double yIntercept, double *key)
+{
+    unsigned long i, n = 0;
+    int trajectory = kind == CacheTrajectory;
+    int adaptive = trajectory && shot->integrator == AdaptiveIntegrator;
+
+    key[n++] = kind;
+    key[n++] = shot->dragFunction;
+    key[n++] = canonical(shot->velocity);
+    key[n++] = canonical(shot->sightHeight);
+    key[n++] = trajectory ? canonical(shot->losAngle) : 0;
+    key[n++] = trajectory ? canonical(shot->zeroAngle) : 0;
+    key[n++] = trajectory ? canonical(shot->windVelocity) : 0;
+    key[n++] = trajectory ? canonical(shot->windAngle) : 0;
+    key[n++] = trajectory ? shot->integrator : 0;
+    key[n++] = adaptive ? canonical(shot->tolerance) : 0;
+    key[n++] = trajectory ? 0 : canonical(zeroRange);
+    key[n++] = trajectory ? 0 : canonical(yIntercept);
+    key[n++] = shot->atmosphere != 0;
+    key[n++] = shot->atmosphere ? canonical(shot->altitude) : 0;
+    key[n++] = shot->atmosphere ? canonical(shot->barometricPressure) : 0;
+    key[n++] = shot->atmosphere ? canonical(shot->temperature) : 0;
+    key[n++] = shot->atmosphere ? canonical(shot->relativeHumidity) : 0;
+    key[n++] = trajectory ? shot->bcCount : 1;
+
+    if (!trajectory) {
+        key[n++] = canonical(shot->bC[0]);
+        return;
+    }
+    for (i = 0; i < shot->bcCount; i++) {
+        key[n++] = canonical(shot->bC[i]);
+        key[n++] = shot->minFPS ? (int) shot->minFPS[i] : 0;
+        key[n++] = shot->maxFPS ? (int) shot->maxFPS[i] : 0;
+    }
+}
+
+/* 64-bit FNV-1a */
+
+unsigned long long libballistics_hashKey(const double *key,
+    unsigned long length)
+{
+    const unsigned char *p = (const unsigned char *) key;
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned long i;
+
+    for (i = 0; i < length * sizeof(double); i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static struct cache_shard *shardFor(ballistics_cache_t cache,
+    unsigned long long hash)
+{
+    return cache->shards + ((hash >> 40) & (cache->shardCount - 1));
+}
+
+/* Shards. All of these are called with the shard locked. */
+
+static struct cache_entry **bucketFor(struct cache_shard *shard,
+    unsigned long long hash)
+{
+    return shard->buckets + (hash & (shard->bucketCount - 1));
+}
+
+static struct cache_entry *findEntry(struct cache_shard *shard,
+    const double *key, unsigned long length, unsigned long long hash)
+{
+    struct cache_entry *e;
+
+    for (e = *bucketFor(shard, hash); e; e = e->hashNext) {
+        if (e->hash == hash && e->keyLength == length
+            && memcmp(e->key, key, length * sizeof(double)) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void removeEntry(struct cache_shard *shard, struct cache_entry *e) {
+    struct cache_entry **p = bucketFor(shard, e->hash);
+
+    while (*p != e)
+        p = &(*p)->hashNext;
+    *p = e->hashNext;
+
+    if (e->clockNext == e) {
+        shard->hand = NULL;
+    } else {
+        e->clockPrev->clockNext = e->clockNext;
+        e->clockNext->clockPrev = e->clockPrev;
+        if (shard->hand == e)
+            shard->hand = e->clockNext;
+    }
+    shard->stats.entries--;
+    shard->stats.bytes -= e->bytes;
+    free(e);
+}
+
+/* Doubles the bucket count; the table simply stays as it is if that
+ * cannot be allocated */
+
+static void growBuckets(struct cache_shard *shard) {
+    unsigned long count = shard->bucketCount * 2, i;
+    struct cache_entry **buckets, *e, *next;
+
+    buckets = calloc(count, sizeof(struct cache_entry *));
+    if (buckets == NULL)
+        return;
+    for (i = 0; i < shard->bucketCount; i++) {
+        for (e = shard->buckets[i]; e; e = next) {
+            next = e->hashNext;
+            e->hashNext = buckets[e->hash & (count - 1)];
+            buckets[e->hash & (count - 1)] = e;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->bucketCount = count;
+}
+
+/* Adds an entry just behind the CLOCK hand, so it is the last one the hand
+ * reaches, then evicts until the shard is back within its limit. Entries
+ * the hand finds referenced get a second chance. */
+
+static void insertEntry(struct cache_shard *shard, struct cache_entry *e) {
+    struct cache_entry **bucket, *victim;
+
+    if (shard->stats.entries >= shard->bucketCount * 2)
+        growBuckets(shard);
+    bucket = bucketFor(shard, e->hash);
+    e->hashNext = *bucket;
+    *bucket = e;
+
+    if (shard->hand == NULL) {
+        e->clockNext = e->clockPrev = e;
+        shard->hand = e;
+    } else {
+        e->clockNext = shard->hand;
+        e->clockPrev = shard->hand->clockPrev;
+        e->clockPrev->clockNext = e;
+        shard->hand->clockPrev = e;
+    }
+    e->referenced = 0;
+    shard->stats.entries++;
+    shard->stats.bytes += e->bytes;
+    shard->stats.insertions++;
+
+    while (shard->stats.bytes > shard->limit && shard->stats.entries > 1) {
+        victim = shard->hand;
+        if (victim == e || victim->referenced) {
+            victim->referenced = 0;
+            shard->hand = victim->clockNext;
+            continue;
+        }
+        removeEntry(shard, victim);
+        shard->stats.evictions++;
+    }
+}
+
+/* Allocates an entry with room for its key and 'rows' table rows */
+
+static struct cache_entry *newEntry(const double *key, unsigned long length,
+    unsigned long long hash, int rows)
+{
+    unsigned long bytes = sizeof(struct cache_entry)
+        + length * sizeof(double) + rows * sizeof(struct trajectory_path);
+    struct cache_entry *e = malloc(bytes);
+
+    if (e == NULL)
+        return NULL;
+    memset(e, 0, sizeof(struct cache_entry));
+    e->table = (struct trajectory_path *) (e + 1);
+    e->key = (double *) (e->table + rows);
+    memcpy(e->key, key, length * sizeof(double));
+    e->keyLength = length;
+    e->hash = hash;
+    e->bytes = bytes;
+    e->rows = rows;
+    return e;
+}
+
+/* Stores a new entry unless an equally good one arrived meanwhile */
+
+static void storeEntry(struct cache_shard *shard, struct cache_entry *e) {
+    struct cache_entry *old;
+
+    if (e->bytes > shard->limit) {
+        free(e);
+        return;
+    }
+    pthread_mutex_lock(&shard->lock);
+    old = findEntry(shard, e->key, e->keyLength, e->hash);
+    if (old && ((unsigned long) old->rows <= old->maxRange
+        || old->maxRange >= e->maxRange))
+    {
+        free(e);
+    } else {
+        if (old)
+            removeEntry(shard, old);
+        insertEntry(shard, e);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+/* Cache */
+
+ballistics_cache_t libballistics_createCache(unsigned long bytes, int shards)
+{
+    ballistics_cache_t cache;
+    int count = 1, i;
+
+    if (shards <= 0)
+        shards = DEFAULT_SHARDS;
+    while (count < shards && count < MAX_SHARDS)
+        count *= 2;
+
+    cache = calloc(1, sizeof(struct ballistics_cache));
+    if (cache == NULL)
+        return NULL;
+    cache->shards = calloc(count, sizeof(struct cache_shard));
+    if (cache->shards == NULL) {
+        free(cache);
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        cache->shards[i].buckets = calloc(INITIAL_BUCKETS,
+            sizeof(struct cache_entry *));
+        if (cache->shards[i].buckets == NULL)
+            break;
+        cache->shards[i].bucketCount = INITIAL_BUCKETS;
+        cache->shards[i].limit = bytes / count;
+        pthread_mutex_init(&cache->shards[i].lock, NULL);
+    }
+    cache->shardCount = i;
+    if (i < count) {
+        libballistics_finishCache(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void libballistics_clearCache(ballistics_cache_t cache) {
+    struct cache_shard *shard;
+    int i;
+
+    for (i = 0; i < cache->shardCount; i++) {
+        shard = cache->shards + i;
+        pthread_mutex_lock(&shard->lock);
+        while (shard->hand)
+            removeEntry(shard, shard->hand);
+        memset(&shard->stats, 0, sizeof(shard->stats));
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void libballistics_finishCache(ballistics_cache_t cache) {
+    int i;
+
+    if (cache == NULL)
+        return;
+    libballistics_clearCache(cache);
+    for (i = 0; i < cache->shardCount; i++) {
+        pthread_mutex_destroy(&cache->shards[i].lock);
+        free(cache->shards[i].buckets);
+    }
+    free(cache->shards);
+    free(cache);
+}
+
+void libballistics_getCacheStats(ballistics_cache_t cache,
+    ballistics_cache_stats_t stats)
+{
+    struct cache_shard *shard;
+    int i;
+
+    memset(stats, 0, sizeof(struct ballistics_cache_stats));
+    for (i = 0; i < cache->shardCount; i++) {
+        shard = cache->shards + i;
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->stats.hits;
+        stats->misses += shard->stats.misses;
+        stats->insertions += shard->stats.insertions;
+        stats->evictions += shard->stats.evictions;
+        stats->entries += shard->stats.entries;
+        stats->bytes += shard->stats.bytes;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/* Coefficient 'i' of a shot, corrected for the atmosphere if asked */
+
+static double shotCoefficient(const struct ballistics_shot *shot,
+    unsigned long i)
+{
+    if (!shot->atmosphere)
+        return shot->bC[i];
+    return libballistics_applyAtmosphere(shot->bC[i], shot->altitude,
+        shot->barometricPressure, shot->temperature, shot->relativeHumidity);
+}
+
+double libballistics_cacheZeroAngle(
+    ballistics_cache_t cache,
+    const struct ballistics_shot *shot,
+    double zeroRange,
+    double yIntercept)
+{
+    double key[SHOT_KEY_HEADER + 1];
+    unsigned long length = libballistics_shotKeyLength(shot, CacheZero);
+    unsigned long long hash;
+    struct cache_shard *shard;
+    struct cache_entry *e;
+    double angle;
+
+    if (shot->bcCount == 0)
+        return 0;
+    libballistics_shotKey(shot, CacheZero, zeroRange, yIntercept, key);
+    hash = libballistics_hashKey(key, length);
+    shard = shardFor(cache, hash);
+
+    pthread_mutex_lock(&shard->lock);
+    e = findEntry(shard, key, length, hash);
+    if (e) {
+        e->referenced = 1;
+        angle = e->angle;
+        shard->stats.hits++;
+    } else {
+        shard->stats.misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    if (e)
+        return angle;
+
+    angle = libballistics_computeZeroAngle(shot->dragFunction,
+        shotCoefficient(shot, 0), shot->velocity, shot->sightHeight,
+        zeroRange, yIntercept);
+    e = newEntry(key, length, hash, 0);
+    if (e) {
+        e->angle = angle;
+        storeEntry(shard, e);
+    }
+    return angle;
+}
+
+/* Copies the first 'rows' rows of 'table' into the context as the
+ * solution out to 'maxRange' yards, or into its sampled output */
+
+static int deliver(ballistics_ctx_t context,
+    const struct ballistics_shot *shot, const struct trajectory_path *table,
+    int rows, unsigned long maxRange, unsigned long maxValidRange)
+{
+    ballistics_output_t output = context->output;
+    int n;
+
+    maxRange++;
+    if (output) {
+        if (libballistics_outputBegin(output, maxRange))
+            return -1;
+        for (n = 0; n < rows; n++) {
+            if (libballistics_outputRow(output, table + n, n)) {
+                rows = n + 1;
+                break;
+            }
+        }
+    } else {
+        if (libballistics_reserveTrajectory(context, maxRange + 1))
+            return -1;
+        memcpy(context->trajectory, table,
+            rows * sizeof(struct trajectory_path));
+        memset(context->trajectory + rows, 0,
+            sizeof(struct trajectory_path) * (maxRange + 1 - rows));
+        context->trajectory[maxRange].range = rows;
+    }
+    context->maxRange = maxRange;
+    context->maxValidRange = maxValidRange;
+    context->muzzleVelocity = shot->velocity;
+    context->headwind = libballistics_headWind(shot->windVelocity,
+        shot->windAngle);
+    context->crosswind = libballistics_crossWind(shot->windVelocity,
+        shot->windAngle);
+    context->steps = 0;
+    return rows;
+}
+
+/* Solves a shot into the context's own table, with any sampled output set
+ * aside. Returns as libballistics_computeTrajectory. */
+
+static int solveShot(const struct ballistics_shot *shot,
+    ballistics_ctx_t context, unsigned long maxRange)
+{
+    ballistics_output_t output = context->output;
+    unsigned long i;
+    int rows;
+
+    libballistics_reset(context);
+    for (i = 0; i < shot->bcCount; i++) {
+        if (libballistics_addBallisticCoefficient(context,
+            shotCoefficient(shot, i), shot->minFPS ? shot->minFPS[i] : 0,
+            shot->maxFPS ? shot->maxFPS[i] : 0))
+            return -1;
+    }
+    if (libballistics_setIntegrator(context, shot->integrator,
+        shot->tolerance))
+        return -1;
+
+    context->output = NULL;
+    rows = libballistics_computeTrajectory(context, shot->dragFunction,
+        shot->velocity, shot->sightHeight, shot->losAngle, shot->zeroAngle,
+        shot->windVelocity, shot->windAngle, maxRange);
+    context->output = output;
+    return rows;
+}
+
+/* Feeds the context's output from the 'rows' row table solveShot left,
+ * then drops the table as libballistics_setOutput would have */
+
+static int outputTable(ballistics_ctx_t context,
+    const struct ballistics_shot *shot, unsigned long maxRange, int rows)
+{
+    int result = deliver(context, shot, context->trajectory, rows, maxRange,
+        context->maxValidRange);
+
+    if (!context->external)
+        free(context->trajectory);
+    context->trajectory = NULL;
+    context->capacity = 0;
+    context->external = 0;
+    context->readonly = 0;
+    return result;
+}
+
+int libballistics_cacheTrajectory(
+    ballistics_cache_t cache,
+    const struct ballistics_shot *shot,
+    ballistics_ctx_t context,
+    unsigned long maxRange)
+{
+    double local[SHOT_KEY_HEADER + 3 * 4], *key = local;
+    unsigned long length = libballistics_shotKeyLength(shot, CacheTrajectory);
+    unsigned long long hash;
+    struct cache_shard *shard;
+    struct cache_entry *e;
+    struct trajectory_path *copy;
+    unsigned long valid;
+    int rows, result;
+
+    if (length > COUNTOF(local)) {
+        key = malloc(length * sizeof(double));
+        if (key == NULL)
+            return -1;
+    }
+    libballistics_shotKey(shot, CacheTrajectory, 0, 0, key);
+    hash = libballistics_hashKey(key, length);
+    shard = shardFor(cache, hash);
+
+    /* Air varied along the flight (libballistics_setAtmosphere) belongs
+     * to the context rather than the shot, so those solves neither use
+     * nor fill the cache */
+    if (context->atmosphere != AtmosphereNone) {
+        if (key != local)
+            free(key);
+        result = solveShot(shot, context, maxRange);
+        return result < 0 || !context->output ? result
+            : outputTable(context, shot, maxRange, result);
+    }
+
+    /* A table answers any range it was solved to, and every range if the
+     * flight ended before its maximum. Sensitivities need a solve. */
+    pthread_mutex_lock(&shard->lock);
+    e = context->sensitivities || context->events ? NULL
+        : findEntry(shard, key, length, hash);
+    if (e && ((unsigned long) e->rows <= e->maxRange
+        || e->maxRange >= maxRange))
+    {
+        e->referenced = 1;
+        shard->stats.hits++;
+        rows = e->rows;
+        valid = e->maxValidRange;
+        if ((unsigned long) rows > maxRange + 1) {
+            rows = maxRange + 1;
+            if (valid > maxRange)
+                valid = maxRange;
+        }
+        if (context->output == NULL) {
+            result = deliver(context, shot, e->table, rows, maxRange, valid);
+            pthread_mutex_unlock(&shard->lock);
+        } else {
+            /* The output's callback may take time or use the cache itself,
+             * so it is fed from a copy with the shard unlocked */
+            copy = malloc(rows * sizeof(struct trajectory_path) + 1);
+            if (copy)
+                memcpy(copy, e->table, rows * sizeof(struct trajectory_path));
+            pthread_mutex_unlock(&shard->lock);
+            result = -1;
+            if (copy)
+                result = deliver(context, shot, copy, rows, maxRange, valid);
+            free(copy);
+        }
+        if (key != local)
+            free(key);
+        return result;
+    }
+    shard->stats.misses++;
+    pthread_mutex_unlock(&shard->lock);
+
+    result = solveShot(shot, context, maxRange);
+    if (result >= 0) {
+        e = newEntry(key, length, hash, result);
+        if (e) {
+            memcpy(e->table, context->trajectory,
+                result * sizeof(struct trajectory_path));
+            e->maxRange = maxRange;
+            e->maxValidRange = context->maxValidRange;
+            storeEntry(shard, e);
+        }
+        if (context->output)
+            result = outputTable(context, shot, maxRange, result);
+    }
+    if (key != local)
+        free(key);
+    return result;
+}
@@ -0,0 +1,464 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Card files.
+ *
+ * A card is one solved shot: its inputs, the zero it was sighted for and
+ * its trajectory table, terminator row included. A file is laid out to be
+ * used where it is mapped:
+ *
+ *     header    card_header
+ *     records   one card_record per card
+ *     index     open addressing hash table of card numbers plus one, keyed
+ *               by the hash of each card's canonical shot key
+ *     keys      each card's key words, then its bands
+ *     tables    each card's trajectory table, on a CARD_ALIGN boundary
+ *
+ * Every field is eight bytes wide or packed in pairs, so nothing is padded
+ * and every double is aligned. Files hold the writer's byte order and are
+ * refused by readers of the other order, since a view can not swap bytes.
+ * A card's offsets are checked when it is used rather than at open, so
+ * opening a file of ten thousand cards touches one page. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "internal.h"
+
+#define CARD_VERSION    1
+#define CARD_ENDIAN     0x01020304u
+#define CARD_ALIGN      64
+
+static const char cardMagic[8] = "LBCARDS";
+
+struct card_header {
+    char magic[8];
+    unsigned int version;
+    unsigned int endian;
+    unsigned int rowSize;           /* sizeof(struct trajectory_path) */
+    unsigned int recordSize;        /* sizeof(struct card_record) */
+    unsigned long long count;
+    unsigned long long slots;       /* Index slots, a power of two */
+    unsigned long long records;     /* Offsets from the start of the file */
+    unsigned long long index;
+    unsigned long long size;
+};
+
+struct card_record {
+    unsigned long long hash;
+    unsigned long long key;         /* Offset of the key */
+    unsigned long long keyLength;   /* Key words */
+    unsigned long long bands;       /* Offset of bC, minFPS and maxFPS */
+    unsigned long long bcCount;
+    unsigned long long table;       /* Offset of the table */
+    unsigned long long maxRange;    /* Terminator row; the table has one more */
+    unsigned long long maxValidRange;
+    long long dragFunction;
+    long long atmosphere;
+    long long integrator;
+    double velocity;
+    double sightHeight;
+    double losAngle;
+    double zeroAngle;
+    double windVelocity;
+    double windAngle;
+    double altitude;
+    double barometricPressure;
+    double temperature;
+    double relativeHumidity;
+    double tolerance;
+    double zeroRange;
+    double yIntercept;
+};
+
+struct ballistics_cards {
+    char *base;
+    unsigned long long size;
+    const struct card_header *header;
+    const struct card_record *records;
+    const unsigned long long *index;
+};
+
+static unsigned long long alignOffset(unsigned long long offset) {
+    return (offset + CARD_ALIGN - 1) & ~(unsigned long long) (CARD_ALIGN - 1);
+}
+
+/* Writing */
+
+static int cardUsable(const struct ballistics_card *card) {
+    ballistics_ctx_t context = card->context;
+
+    /* Cards are keyed by the shot alone, which does not record air
+     * varied along the flight; drag curve numbers mean nothing to another
+     * process */
+    return context != NULL && context->output == NULL
+        && context->atmosphere == AtmosphereNone
+        && card->shot.dragFunction < LIBBALLISTICS_DRAG_CURVE
+        && context->trajectory != NULL && context->maxRange > 0
+        && card->shot.bcCount > 0 && card->shot.bC != NULL;
+}
+
+/* Writes zeros from '*at' up to 'to' */
+
+static int pad(FILE *f, unsigned long long *at, unsigned long long to) {
+    static const char zeros[CARD_ALIGN];
+    unsigned long long n;
+
+    while (*at < to) {
+        n = to - *at < CARD_ALIGN ? to - *at : CARD_ALIGN;
+        if (fwrite(zeros, 1, n, f) != n)
+            return -1;
+        *at += n;
+    }
+    return 0;
+}
+
+static int writeBand(FILE *f, const double *values, unsigned long count) {
+    double zero = 0;
+    unsigned long i;
+
+    if (values)
+        return fwrite(values, sizeof(double), count, f) == count ? 0 : -1;
+    for (i = 0; i < count; i++) {
+        if (fwrite(&zero, sizeof(double), 1, f) != 1)
+            return -1;
+    }
+    return 0;
+}
+
+/* Fills the records and index and returns the file size. 'key' has room
+ * for the longest key. */
+
+static unsigned long long layout(const struct ballistics_card *cards,
+    unsigned long count, struct card_header *header,
+    struct card_record *records, unsigned long long *index, double *key)
+{
+    const struct ballistics_shot *shot;
+    struct card_record *r;
+    unsigned long long offset, mask = header->slots - 1, slot;
+    unsigned long i;
+
+    offset = header->index + header->slots * sizeof(unsigned long long);
+    for (i = 0; i < count; i++) {
+        shot = &cards[i].shot;
+        r = records + i;
+        r->keyLength = libballistics_shotKeyLength(shot, CacheTrajectory);
+        libballistics_shotKey(shot, CacheTrajectory, 0, 0, key);
+        r->hash = libballistics_hashKey(key, r->keyLength);
+        r->key = offset;
+        offset += r->keyLength * sizeof(double);
+        r->bands = offset;
+        r->bcCount = shot->bcCount;
+        offset += 3 * shot->bcCount * sizeof(double);
+
+        r->maxRange = cards[i].context->maxRange;
+        r->maxValidRange = cards[i].context->maxValidRange;
+        r->dragFunction = shot->dragFunction;
+        r->atmosphere = shot->atmosphere;
+        r->integrator = shot->integrator;
+        r->velocity = shot->velocity;
+        r->sightHeight = shot->sightHeight;
+        r->losAngle = shot->losAngle;
+        r->zeroAngle = shot->zeroAngle;
+        r->windVelocity = shot->windVelocity;
+        r->windAngle = shot->windAngle;
+        r->altitude = shot->altitude;
+        r->barometricPressure = shot->barometricPressure;
+        r->temperature = shot->temperature;
+        r->relativeHumidity = shot->relativeHumidity;
+        r->tolerance = shot->tolerance;
+        r->zeroRange = cards[i].zeroRange;
+        r->yIntercept = cards[i].yIntercept;
+
+        /* Later duplicates of a key sit further along its probe sequence,
+         * so lookups find the first card written */
+        for (slot = r->hash & mask; index[slot]; slot = (slot + 1) & mask)
+            ;
+        index[slot] = i + 1;
+    }
+    for (i = 0; i < count; i++) {
+        offset = alignOffset(offset);
+        records[i].table = offset;
+        offset += (records[i].maxRange + 1) * sizeof(struct trajectory_path);
+    }
+    return offset;
+}
+
+int libballistics_writeCards(const char *path,
+    const struct ballistics_card *cards, unsigned long count)
+{
+    struct card_header header;
+    struct card_record *records;
+    unsigned long long *index, at;
+    unsigned long i, longest = 0;
+    double *key;
+    FILE *f;
+    int ok;
+
+    if (count > 0 && cards == NULL)
+        return -1;
+    for (i = 0; i < count; i++) {
+        if (!cardUsable(cards + i))
+            return -1;
+        if (cards[i].shot.bcCount > longest)
+            longest = cards[i].shot.bcCount;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cardMagic, sizeof(cardMagic));
+    header.version = CARD_VERSION;
+    header.endian = CARD_ENDIAN;
+    header.rowSize = sizeof(struct trajectory_path);
+    header.recordSize = sizeof(struct card_record);
+    header.count = count;
+    for (header.slots = 1; header.slots < 2 * (unsigned long long) count; )
+        header.slots <<= 1;
+    header.records = sizeof(struct card_header);
+    header.index = header.records + count * sizeof(struct card_record);
+
+    records = calloc(count ? count : 1, sizeof(struct card_record));
+    index = calloc(header.slots, sizeof(unsigned long long));
+    key = malloc((SHOT_KEY_HEADER + 3 * longest) * sizeof(double));
+    f = records && index && key ? fopen(path, "wb") : NULL;
+    if (f == NULL) {
+        free(records);
+        free(index);
+        free(key);
+        return -1;
+    }
+    header.size = layout(cards, count, &header, records, index, key);
+
+    ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && fwrite(records, sizeof(struct card_record), count, f) == count
+        && fwrite(index, sizeof(unsigned long long), header.slots, f)
+            == header.slots;
+    for (i = 0; ok && i < count; i++) {
+        const struct ballistics_shot *shot = &cards[i].shot;
+
+        libballistics_shotKey(shot, CacheTrajectory, 0, 0, key);
+        ok = fwrite(key, sizeof(double), records[i].keyLength, f)
+                == records[i].keyLength
+            && writeBand(f, shot->bC, shot->bcCount) == 0
+            && writeBand(f, shot->minFPS, shot->bcCount) == 0
+            && writeBand(f, shot->maxFPS, shot->bcCount) == 0;
+    }
+    at = count ? records[count - 1].bands
+        + 3 * records[count - 1].bcCount * sizeof(double) : header.size;
+    for (i = 0; ok && i < count; i++) {
+        unsigned long long rows = records[i].maxRange + 1;
+
+        ok = pad(f, &at, records[i].table) == 0
+            && fwrite(cards[i].context->trajectory,
+                sizeof(struct trajectory_path), rows, f) == rows;
+        at += rows * sizeof(struct trajectory_path);
+    }
+    if (fclose(f) != 0)
+        ok = 0;
+    free(records);
+    free(index);
+    free(key);
+    return ok ? 0 : -1;
+}
+
+/* Reading */
+
+static int within(ballistics_cards_t cards, unsigned long long offset,
+    unsigned long long bytes)
+{
+    return offset <= cards->size && bytes <= cards->size - offset
+        && offset % sizeof(double) == 0;
+}
+
+/* Whether a record's offsets and sizes stay inside the file */
+
+static int recordUsable(ballistics_cards_t cards,
+    const struct card_record *r)
+{
+    unsigned long long rows = cards->size / sizeof(struct trajectory_path);
+    const struct trajectory_path *table;
+
+    if (r->bcCount == 0 || r->bcCount > cards->size
+        || r->dragFunction >= LIBBALLISTICS_DRAG_CURVE
+        || r->keyLength != SHOT_KEY_HEADER + 3 * r->bcCount
+        || !within(cards, r->key, r->keyLength * sizeof(double))
+        || !within(cards, r->bands, 3 * r->bcCount * sizeof(double))
+        || r->maxRange == 0 || r->maxRange >= rows
+        || !within(cards, r->table,
+            (r->maxRange + 1) * sizeof(struct trajectory_path)))
+        return 0;
+    table = (const struct trajectory_path *) (cards->base + r->table);
+    return table[r->maxRange].range >= 0
+        && table[r->maxRange].range <= r->maxRange
+        && r->maxValidRange <= r->maxRange;
+}
+
+ballistics_cards_t libballistics_openCards(const char *path) {
+    ballistics_cards_t cards;
+    const struct card_header *h;
+    struct stat st;
+    void *base;
+    int fd, ok;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0
+        || (unsigned long long) st.st_size < sizeof(struct card_header)) {
+        close(fd);
+        return NULL;
+    }
+    /* Read only: contexts viewing a card share its rows, so none may write
+     * them (see libballistics_viewCard) */
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    h = base;
+    ok = memcmp(h->magic, cardMagic, sizeof(cardMagic)) == 0
+        && h->version == CARD_VERSION && h->endian == CARD_ENDIAN
+        && h->rowSize == sizeof(struct trajectory_path)
+        && h->recordSize == sizeof(struct card_record)
+        && h->size == (unsigned long long) st.st_size
+        && h->records == sizeof(struct card_header)
+        && h->count <= h->size / sizeof(struct card_record)
+        && h->index == h->records + h->count * sizeof(struct card_record)
+        && h->slots > 0 && (h->slots & (h->slots - 1)) == 0
+        && h->slots <= h->size / sizeof(unsigned long long)
+        && h->index + h->slots * sizeof(unsigned long long) <= h->size;
+
+    cards = ok ? malloc(sizeof(struct ballistics_cards)) : NULL;
+    if (cards == NULL) {
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    cards->base = base;
+    cards->size = h->size;
+    cards->header = h;
+    cards->records = (const struct card_record *) (cards->base + h->records);
+    cards->index = (const unsigned long long *) (cards->base + h->index);
+    return cards;
+}
+
+void libballistics_closeCards(ballistics_cards_t cards) {
+    if (cards == NULL)
+        return;
+    munmap(cards->base, cards->size);
+    free(cards);
+}
+
+unsigned long libballistics_countCards(ballistics_cards_t cards) {
+    return (unsigned long) cards->header->count;
+}
+
+long libballistics_findCard(ballistics_cards_t cards,
+    const struct ballistics_shot *shot)
+{
+    const struct card_record *r;
+    unsigned long long hash, mask, slot, probes, n;
+    unsigned long length;
+    double local[SHOT_KEY_HEADER + 3 * 4], *key = local;
+    long found = -1;
+
+    if (shot->bcCount == 0 || shot->bC == NULL)
+        return -1;
+    length = libballistics_shotKeyLength(shot, CacheTrajectory);
+    if (length > COUNTOF(local)) {
+        key = malloc(length * sizeof(double));
+        if (key == NULL)
+            return -1;
+    }
+    libballistics_shotKey(shot, CacheTrajectory, 0, 0, key);
+    hash = libballistics_hashKey(key, length);
+
+    mask = cards->header->slots - 1;
+    slot = hash & mask;
+    for (probes = 0; probes <= mask; probes++, slot = (slot + 1) & mask) {
+        n = cards->index[slot];
+        if (n == 0 || n > cards->header->count)
+            break;
+        r = cards->records + (n - 1);
+        if (r->hash == hash && r->keyLength == length
+            && recordUsable(cards, r)
+            && memcmp(cards->base + r->key, key,
+                length * sizeof(double)) == 0) {
+            found = (long) (n - 1);
+            break;
+        }
+    }
+    if (key != local)
+        free(key);
+    return found;
+}
+
+int libballistics_viewCard(ballistics_cards_t cards, unsigned long index,
+    ballistics_ctx_t context, ballistics_card_t card)
+{
+    const struct card_record *r;
+    trajectory_path_t table;
+    const double *bands;
+
+    if (index >= cards->header->count)
+        return -1;
+    r = cards->records + index;
+    if (!recordUsable(cards, r))
+        return -1;
+    table = (trajectory_path_t) (cards->base + r->table);
+    libballistics_setTrajectoryBuffer(context, table,
+        (unsigned long) r->maxRange + 1);
+    context->readonly = 1;
+    context->maxRange = (unsigned long) r->maxRange;
+    context->maxValidRange = (unsigned long) r->maxValidRange;
+    context->muzzleVelocity = r->velocity;
+    context->headwind = libballistics_headWind(r->windVelocity, r->windAngle);
+    context->crosswind = libballistics_crossWind(r->windVelocity,
+        r->windAngle);
+    context->steps = 0;
+
+    if (card) {
+        bands = (const double *) (cards->base + r->bands);
+        memset(card, 0, sizeof(struct ballistics_card));
+        card->shot.dragFunction = (int) r->dragFunction;
+        card->shot.bcCount = (unsigned long) r->bcCount;
+        card->shot.bC = bands;
+        card->shot.minFPS = bands + r->bcCount;
+        card->shot.maxFPS = bands + 2 * r->bcCount;
+        card->shot.velocity = r->velocity;
+        card->shot.sightHeight = r->sightHeight;
+        card->shot.losAngle = r->losAngle;
+        card->shot.zeroAngle = r->zeroAngle;
+        card->shot.windVelocity = r->windVelocity;
+        card->shot.windAngle = r->windAngle;
+        card->shot.atmosphere = (int) r->atmosphere;
+        card->shot.altitude = r->altitude;
+        card->shot.barometricPressure = r->barometricPressure;
+        card->shot.temperature = r->temperature;
+        card->shot.relativeHumidity = r->relativeHumidity;
+        card->shot.integrator = (int) r->integrator;
+        card->shot.tolerance = r->tolerance;
+        card->zeroRange = r->zeroRange;
+        card->yIntercept = r->yIntercept;
+        card->context = context;
+    }
+    return (int) libballistics_tableRows(context);
+}
@@ -0,0 +1,225 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* User drag curves.
+ *
+ * A curve is registered once from Cd/Mach points, for instance from
+ * Doppler radar, and then used like a built-in drag function. Registration
+ * fits a monotone cubic (Fritsch-Carlson) through the points, so the curve
+ * never overshoots the data between them, and stores each interval's
+ * polynomial in velocity at the standard speed of sound. Intervals are
+ * kept in descending velocity order as the built-in segment tables are,
+ * with a constant Cd beyond the first and last points, so the solvers'
+ * cursors and schedules walk them the same way. A bucket index gives the
+ * interval for a velocity directly, for lookups without a cursor.
+ *
+ * Curves are never freed; each has a slot in a fixed table, written once
+ * under a lock after the curve is complete, so solvers read it without
+ * one. */
+
+#include <pthread.h>
+#include "internal.h"
+
+/* Buckets per Mach number in a curve's index */
+#define CURVE_INDEX_SCALE   40
+
+static struct drag_curve *curves[LIBBALLISTICS_MAX_DRAG_CURVES];
+static int curveCount = 0;
+static pthread_mutex_t curveLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Fritsch-Carlson slopes for a monotone cubic through the points: the
+ * average of the neighbouring secants, zero at local extremes, and scaled
+ * down on intervals where they would make the cubic overshoot */
+
+static void monotoneSlopes(const double *x, const double *y, int n,
+    double *m)
+{
+    double d0, d1, a, b, r;
+    int k;
+
+    for (k = 0; k < n; k++) {
+        d0 = k > 0 ? (y[k] - y[k-1]) / (x[k] - x[k-1]) : 0;
+        d1 = k < n-1 ? (y[k+1] - y[k]) / (x[k+1] - x[k]) : 0;
+        if (k == 0)
+            m[k] = d1;
+        else if (k == n-1)
+            m[k] = d0;
+        else if (d0 * d1 <= 0)
+            m[k] = 0;
+        else
+            m[k] = (d0 + d1) / 2;
+    }
+    for (k = 0; k < n-1; k++) {
+        d0 = (y[k+1] - y[k]) / (x[k+1] - x[k]);
+        if (d0 == 0) {
+            m[k] = m[k+1] = 0;
+            continue;
+        }
+        a = m[k] / d0;
+        b = m[k+1] / d0;
+        r = a*a + b*b;
+        if (r > 9) {
+            r = 3 / sqrt(r);
+            m[k] = r * a * d0;
+            m[k+1] = r * b * d0;
+        }
+    }
+}
+
+int libballistics_addDragCurve(
+    const double *mach,
+    const double *cd,
+    int count)
+{
+    const double c = LIBBALLISTICS_SPEED_OF_SOUND;
+    struct drag_curve *curve;
+    struct curve_segment *seg;
+    double *m, h, d, v;
+    int k, n, b, id;
+
+    if (mach == NULL || cd == NULL || count < 2 || !(mach[0] >= 0))
+        return -1;
+    for (k = 0; k < count; k++) {
+        if (!(cd[k] > 0) || cd[k] > 100
+            || (k > 0 && !(mach[k] > mach[k-1])))
+            return -1;
+    }
+    if (mach[count-1] * c >= LIBBALLISTICS_MAX_VELOCITY)
+        return -1;
+
+    /* Constant ends, the count - 1 cubics, and the index */
+    n = count + (mach[0] > 0);
+    curve = calloc(1, sizeof(struct drag_curve));
+    m = malloc(count * sizeof(double));
+    if (curve)
+        curve->segments = malloc(n * sizeof(struct curve_segment));
+    if (curve && curve->segments) {
+        curve->buckets = (int) (mach[count-1] * CURVE_INDEX_SCALE) + 2;
+        curve->index = malloc(curve->buckets * sizeof(int));
+    }
+    if (!curve || !m || !curve->segments || !curve->index) {
+        if (curve) {
+            free(curve->segments);
+            free(curve->index);
+        }
+        free(curve);
+        free(m);
+        return -1;
+    }
+
+    monotoneSlopes(mach, cd, count, m);
+    seg = curve->segments;
+    seg->velocity = mach[count-1] * c;
+    seg->c[0] = cd[count-1];
+    seg->c[1] = seg->c[2] = seg->c[3] = 0;
+    for (k = count-2; k >= 0; k--) {
+        seg++;
+        h = mach[k+1] - mach[k];
+        d = (cd[k+1] - cd[k]) / h;
+        seg->velocity = mach[k] * c;
+        seg->c[0] = cd[k];
+        seg->c[1] = m[k] / c;
+        seg->c[2] = (3*d - 2*m[k] - m[k+1]) / h / (c*c);
+        seg->c[3] = (m[k] + m[k+1] - 2*d) / (h*h) / (c*c*c);
+    }
+    if (mach[0] > 0) {
+        seg++;
+        seg->velocity = 0;
+        seg->c[0] = cd[0];
+        seg->c[1] = seg->c[2] = seg->c[3] = 0;
+    }
+    free(m);
+    curve->count = n;
+
+    /* index[b] is the segment for the start of bucket b */
+    curve->bucketScale = CURVE_INDEX_SCALE / c;
+    for (b = 0, k = n - 1; b < curve->buckets; b++) {
+        v = b / curve->bucketScale;
+        while (k > 0 && v > curve->segments[k-1].velocity)
+            k--;
+        curve->index[b] = k;
+    }
+
+    pthread_mutex_lock(&curveLock);
+    if (curveCount < LIBBALLISTICS_MAX_DRAG_CURVES) {
+        id = LIBBALLISTICS_DRAG_CURVE + curveCount;
+        curve->id = id;
+        curves[curveCount++] = curve;
+    } else {
+        id = -1;
+    }
+    pthread_mutex_unlock(&curveLock);
+
+    if (id < 0) {
+        free(curve->segments);
+        free(curve->index);
+        free(curve);
+    }
+    return id;
+}
+
+const struct drag_curve *libballistics_dragCurve(int dragFunction) {
+    int i = dragFunction - LIBBALLISTICS_DRAG_CURVE;
+
+    if (i < 0 || i >= LIBBALLISTICS_MAX_DRAG_CURVES)
+        return NULL;
+    return curves[i];
+}
+
+int libballistics_curveIndex(const struct drag_curve *curve, double velocity)
+{
+    double b = velocity * curve->bucketScale;
+    int i;
+
+    if (!(b >= 0))
+        return curve->count - 1;
+    if (b >= curve->buckets)
+        return 0;
+
+    /* The bucket starts at or below the velocity, so at most a breakpoint
+     * or two lie between them */
+    i = curve->index[(int) b];
+    while (i > 0 && velocity > curve->segments[i - 1].velocity)
+        i--;
+    return i;
+}
+
+double libballistics_curveRetardation(
+    const struct drag_curve *curve,
+    int *index,
+    double bC,
+    double velocity)
+{
+    const struct curve_segment *segments = curve->segments;
+    double vp = velocity;
+    int i = *index;
+
+    while (i > 0 && vp > segments[i - 1].velocity)
+        i--;
+    while (i < curve->count && !(vp > segments[i].velocity))
+        i++;
+    *index = i;
+
+    if (i < curve->count && vp > 0 && vp < LIBBALLISTICS_MAX_VELOCITY)
+        return LIBBALLISTICS_CURVE_K * libballistics_curveCd(segments + i, vp)
+            * vp * vp / bC;
+
+    return -1;
+}
@@ -0,0 +1,100 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Runtime instruction set selection.
+ *
+ * The library is built for its target's baseline. Kernels that gain from
+ * wider vectors (batch trajectories, drag table interpolation) are
+ * compiled once per instruction set with target attributes and pick one
+ * on each call from the level here: the best the processor supports,
+ * lowered by the LIBBALLISTICS_SIMD environment variable or by
+ * libballistics_setSimdLevel. The level is worked out on first use; two
+ * threads racing to do so store the same value. */
+
+#include <stdlib.h>
+#include <string.h>
+#include "internal.h"
+
+static const char *simdNames[] = { "generic", "sse2", "avx2", "avx512" };
+
+static int simdDetected = -1;
+static int simdLevel = -1;
+
+static int detectSimd(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SimdAVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdAVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdSSE2;
+#endif
+    return SimdGeneric;
+}
+
+/* Level named by LIBBALLISTICS_SIMD, or -1 if unset or unknown */
+
+static int environmentSimd(void) {
+    const char *name = getenv("LIBBALLISTICS_SIMD");
+    int i;
+
+    if (name == NULL)
+        return -1;
+    for (i = 0; i < (int) COUNTOF(simdNames); i++) {
+        if (strcmp(name, simdNames[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int libballistics_simdLevel(void) {
+    int level = simdLevel;
+
+    if (level < 0) {
+        if (simdDetected < 0)
+            simdDetected = detectSimd();
+        level = environmentSimd();
+        if (level < 0 || level > simdDetected)
+            level = simdDetected;
+        simdLevel = level;
+    }
+    return level;
+}
+
+int libballistics_getSimdLevel(void) {
+    return libballistics_simdLevel();
+}
+
+int libballistics_setSimdLevel(int level) {
+    if (level < 0) {
+        simdLevel = -1;
+        return libballistics_simdLevel();
+    }
+    libballistics_simdLevel();
+    simdLevel = level < simdDetected ? level : simdDetected;
+    return simdLevel;
+}
+
+const char *libballistics_getSimdName(int level) {
+    if (level < 0 || level >= (int) COUNTOF(simdNames))
+        return NULL;
+    return simdNames[level];
+}
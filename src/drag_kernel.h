@@ -0,0 +1,112 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* dragForModelArray kernel template, included by retardation.c once per
+ * instruction set. The includer defines:
+ *
+ *     DRAG_ISA       suffix for the generated name (sse2, avx2, ...)
+ *     DRAG_TARGET    target attribute string; omit for a generic build
+ *     DRAG_LANES     number of doubles per vector
+ *
+ * dragArray_<isa>() runs machForVelocity DRAG_LANES elements at a time,
+ * with the same operations in the same order, then dragInterpolate on
+ * each element, so results are identical to libballistics_dragForModel.
+ * Contraction into FMA would round differently: the target strings leave
+ * FMA out, and since AVX-512F brings it back regardless, the kernels are
+ * also built with fp-contract off. */
+
+#define DRAG_PASTE_(name, isa)	name##_##isa
+#define DRAG_PASTE(name, isa)	DRAG_PASTE_(name, isa)
+#define DRAG_FN(name)		DRAG_PASTE(name, DRAG_ISA)
+
+#ifdef DRAG_TARGET
+#define DRAG_INLINE	static inline __attribute__((always_inline, \
+	target(DRAG_TARGET), optimize("fp-contract=off")))
+#define DRAG_KERNEL	static __attribute__((target(DRAG_TARGET), \
+	optimize("fp-contract=off")))
+#else
+#define DRAG_INLINE	static inline __attribute__((always_inline))
+#define DRAG_KERNEL	static
+#endif
+
+typedef double DRAG_FN(vdrag)
+	__attribute__((vector_size(DRAG_LANES * sizeof(double))));
+typedef double DRAG_FN(vdragu)
+	__attribute__((vector_size(DRAG_LANES * sizeof(double)), aligned(8)));
+typedef long long DRAG_FN(vdragmask)
+	__attribute__((vector_size(DRAG_LANES * sizeof(double))));
+
+#define vdrag		DRAG_FN(vdrag)
+#define vdragu		DRAG_FN(vdragu)
+#define vdragmask	DRAG_FN(vdragmask)
+
+DRAG_INLINE vdrag DRAG_FN(vsqrt)(vdrag a) {
+#if !defined(DRAG_TARGET)
+	int i;
+	for (i = 0; i < DRAG_LANES; i++)
+		a[i] = sqrt(a[i]);
+	return a;
+#elif DRAG_LANES == 2
+	return (vdrag) _mm_sqrt_pd((__m128d) a);
+#elif DRAG_LANES == 4
+	return (vdrag) _mm256_sqrt_pd((__m256d) a);
+#else
+	return (vdrag) _mm512_sqrt_pd((__m512d) a);
+#endif
+}
+
+DRAG_KERNEL void DRAG_FN(dragArray)(const struct drag_table *dragTable,
+	const double *velocity, const double *temperature, double *cd,
+	unsigned long count)
+{
+	vdrag v, t, mach, zero = { 0 };
+	vdragmask valid;
+	unsigned long n;
+
+	/* machForVelocity, into cd. The square root and division are most of
+	 * the work. */
+	for (n = 0; n + DRAG_LANES <= count; n += DRAG_LANES) {
+		v = *(const vdragu *) (velocity + n);
+		t = *(const vdragu *) (temperature + n);
+		t = DRAG_FN(vsqrt)(t + LIBBALLISTICS_ABSOLUTE_ZERO);
+		mach = v / (t * 49.0223);
+		valid = (mach >= 0.0) & (mach < DRAG_MAX_MACH);
+		mach = (vdrag) (((vdragmask) mach & valid)
+			| ((vdragmask) (zero - 1.0) & ~valid));
+		*(vdragu *) (cd + n) = mach;
+	}
+	for (; n < count; n++)
+		cd[n] = machForVelocity(velocity[n], temperature[n]);
+
+	/* dragInterpolate, in place. Its table lookups differ lane by lane;
+	 * assembling vectors from them costs more than the scalar
+	 * interpolation. */
+	for (n = 0; n < count; n++)
+		cd[n] = dragInterpolate(dragTable, cd[n]);
+}
+
+#undef vdrag
+#undef vdragu
+#undef vdragmask
+#undef DRAG_INLINE
+#undef DRAG_KERNEL
+#undef DRAG_ISA
+#undef DRAG_TARGET
+#undef DRAG_LANES
@@ -0,0 +1,154 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Trajectory events.
+ *
+ * Each event is a sign change of a function of the state: velocity less a
+ * Mach number, vertical velocity, or height. A step is checked by the
+ * function at its ends, and a step with a change in the event's direction
+ * is searched on its interpolant by regula falsi with the Illinois
+ * modification. Only the first occurrence of an event is kept, so a solve
+ * searches at most EventCount times. */
+
+#include <string.h>
+#include "internal.h"
+
+#define EVENT_TOLERANCE     1e-12   /* Fraction of the step */
+#define EVENT_ITERATIONS    60
+
+static const double eventMach[] = { 1.2, 1.0, 0.8 };
+
+int libballistics_setEvents(
+    ballistics_ctx_t context,
+    ballistics_events_t events)
+{
+    context->events = events;
+    return 0;
+}
+
+void libballistics_eventsBegin(ballistics_events_t events) {
+    double speedOfSound = events->speedOfSound;
+
+    memset(events, 0, sizeof(struct ballistics_events));
+    events->speedOfSound = speedOfSound;
+}
+
+/* Event function, arranged to fall through zero. 'speed' is the speed of
+ * the state. */
+
+static double eventValue(ballistics_events_t events, int e,
+    const struct event_state *s, double speed)
+{
+    double a = events->speedOfSound > 0 ? events->speedOfSound
+        : LIBBALLISTICS_SPEED_OF_SOUND;
+
+    switch (e) {
+        case EventMach12:
+        case EventMach10:
+        case EventMach08:
+            return speed - eventMach[e] * a;
+        case EventApex:         return s->vy;
+        case EventZeroRising:   return -s->y;
+        default:                return s->y;
+    }
+}
+
+static double speedOf(const struct event_state *s) {
+    return sqrt(s->vx*s->vx + s->vy*s->vy);
+}
+
+static void linear(const struct event_state *from,
+    const struct event_state *to, double theta, struct event_state *s)
+{
+    s->x = from->x + theta * (to->x - from->x);
+    s->y = from->y + theta * (to->y - from->y);
+    s->vx = from->vx + theta * (to->vx - from->vx);
+    s->vy = from->vy + theta * (to->vy - from->vy);
+    s->t = from->t + theta * (to->t - from->t);
+}
+
+static void stateAt(const struct event_state *from,
+    const struct event_state *to, event_interpolant at, const void *arg,
+    double theta, struct event_state *s)
+{
+    if (at)
+        at(arg, theta, s);
+    else
+        linear(from, to, theta, s);
+}
+
+/* Locates event 'e', whose function goes from f0 > 0 to f1 <= 0 over the
+ * step, and records it */
+
+static void eventLocate(ballistics_events_t events, int e,
+    const struct event_state *from, const struct event_state *to,
+    event_interpolant at, const void *arg, double f0, double f1)
+{
+    struct event_state s = *to;
+    double a = 0, b = 1, fa = f0, fb = f1, theta, f;
+    int i, side = 0;
+
+    for (i = 0; i < EVENT_ITERATIONS && b - a > EVENT_TOLERANCE; i++) {
+        theta = (a * fb - b * fa) / (fb - fa);
+        if (!(theta > a && theta < b))
+            theta = (a + b) / 2;
+        stateAt(from, to, at, arg, theta, &s);
+        f = eventValue(events, e, &s, speedOf(&s));
+        if (f > 0) {
+            a = theta, fa = f;
+            if (side == -1)
+                fb /= 2;
+            side = -1;
+        } else {
+            b = theta, fb = f;
+            if (side == 1)
+                fa /= 2;
+            side = 1;
+        }
+        if (f == 0)
+            break;
+    }
+    events->found |= LIBBALLISTICS_EVENT(e);
+    events->range[e] = s.x / 3;
+    events->time[e] = s.t;
+    events->velocity[e] = speedOf(&s);
+    events->pathY[e] = s.y * 12;
+}
+
+void libballistics_eventsStep(ballistics_events_t events,
+    const struct event_state *from, const struct event_state *to,
+    event_interpolant at, const void *arg)
+{
+    double speed0, speed1, f0, f1;
+    int e;
+
+    if (events->found == LIBBALLISTICS_EVENT(EventCount) - 1)
+        return;
+    speed0 = speedOf(from);
+    speed1 = speedOf(to);
+    for (e = 0; e < EventCount; e++) {
+        if (events->found & LIBBALLISTICS_EVENT(e))
+            continue;
+        f0 = eventValue(events, e, from, speed0);
+        f1 = eventValue(events, e, to, speed1);
+        if (f0 > 0 && f1 <= 0)
+            eventLocate(events, e, from, to, at, arg, f0, f1);
+    }
+}
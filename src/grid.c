@@ -0,0 +1,502 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Precomputed solution grids.
+ *
+ * A grid holds, for every node (drag function, BC, muzzle velocity), the
+ * path, flight time and wind lag (t - x/v0, from which windage follows for
+ * any crosswind) every 'step' yards. Nodes are evenly spaced, so a query
+ * finds its cell by arithmetic and interpolates over a stencil of nodes and
+ * rows: 2 x 2 x 2 for the multilinear answer and up to 4 x 4 x 4 for the
+ * cubic one. Stencils are shifted inwards at the edges of the grid rather
+ * than extrapolating. Rows a node's flight never reached hold GRID_HOLE. */
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "internal.h"
+
+#define GRID_VALUES     3       /* pathY, time, lag */
+#define GRID_HOLE       HUGE_VAL
+#define GRID_TOLERANCE  1e-10
+#define GRID_STEP       10
+
+#define GRID_VERSION    1
+#define GRID_ENDIAN     0x01020304u
+#define GRID_HEADER     13
+
+static const char gridMagic[8] = "LBGRID\0";
+
+struct ballistics_grid {
+    struct ballistics_grid_spec spec;
+    int *dragFunction;
+    unsigned long rows;
+    double *data;
+};
+
+/* Build state shared by the threads */
+
+struct grid_build {
+    ballistics_grid_t grid;
+    unsigned long next, nodes;
+    pthread_mutex_t lock;
+};
+
+/* Stencil and weights along one axis */
+
+struct grid_axis {
+    int start, count;
+    double w[4];
+};
+
+static double gridBC(const struct ballistics_grid_spec *spec, int i) {
+    return spec->bCMin + (spec->bCMax - spec->bCMin) * i / (spec->bCCount - 1);
+}
+
+static double gridVelocity(const struct ballistics_grid_spec *spec, int j) {
+    return spec->velocityMin + (spec->velocityMax - spec->velocityMin) * j
+        / (spec->velocityCount - 1);
+}
+
+static double *gridNode(ballistics_grid_t grid, int model, int i, int j) {
+    const struct ballistics_grid_spec *spec = &grid->spec;
+
+    return grid->data + (((unsigned long) model * spec->bCCount + i)
+        * spec->velocityCount + j) * grid->rows * GRID_VALUES;
+}
+
+/* Solves one node. The zero from libballistics_solveZeroAngle is refined
+ * on the node's own solution, treating a small change of angle as a
+ * rotation of the path. */
+
+static void gridSolve(ballistics_grid_t grid, ballistics_ctx_t context,
+    unsigned long node)
+{
+    const struct ballistics_grid_spec *spec = &grid->spec;
+    struct zero_solution zero;
+    unsigned long zeroRange = spec->zeroRange, r, range;
+    int j = node % spec->velocityCount;
+    int i = node / spec->velocityCount % spec->bCCount;
+    int model = node / spec->velocityCount / spec->bCCount;
+    int drag = grid->dragFunction[model], rows = -1, k;
+    double bC = gridBC(spec, i), velocity = gridVelocity(spec, j);
+    double *out = gridNode(grid, model, i, j), error;
+
+    libballistics_reset(context);
+    if (libballistics_solveZeroAngle(drag, bC, velocity, spec->sightHeight,
+        zeroRange, 0, &zero) == 0
+        && libballistics_addBallisticCoefficient(context, bC, 0, 0) == 0)
+    {
+        for (k = 0; k < 4; k++) {
+            rows = libballistics_computeTrajectory(context, drag, velocity,
+                spec->sightHeight, 0, zero.angle, 0, 0, spec->maxRange);
+            if (rows <= (int) zeroRange) {
+                rows = -1;
+                break;
+            }
+            error = context->trajectory[zeroRange].pathY;
+            if (fabs(error) < 1e-7)
+                break;
+            zero.angle -= libballistics_rad2deg(atan(error
+                / (36.0 * zeroRange)));
+        }
+    }
+
+    for (r = 0; r < grid->rows; r++, out += GRID_VALUES) {
+        range = r * spec->step;
+        if ((long) range >= rows) {
+            out[0] = out[1] = out[2] = GRID_HOLE;
+            continue;
+        }
+        out[0] = context->trajectory[range].pathY;
+        out[1] = context->trajectory[range].time;
+        out[2] = out[1] - 3.0 * range / velocity;
+    }
+}
+
+static void *gridWorker(void *arg) {
+    struct grid_build *build = arg;
+    ballistics_ctx_t context = libballistics_create();
+    unsigned long node;
+
+    if (context == NULL)
+        return NULL;
+    libballistics_setIntegrator(context, AdaptiveIntegrator, GRID_TOLERANCE);
+    for (;;) {
+        pthread_mutex_lock(&build->lock);
+        node = build->next++;
+        pthread_mutex_unlock(&build->lock);
+        if (node >= build->nodes)
+            break;
+        gridSolve(build->grid, context, node);
+    }
+    libballistics_finish(context);
+    return NULL;
+}
+
+static int gridValid(const struct ballistics_grid_spec *spec) {
+    return spec->dragCount > 0 && spec->bCCount >= 2
+        && spec->velocityCount >= 2 && spec->bCMin > 0
+        && spec->bCMax > spec->bCMin && spec->velocityMin > 0
+        && spec->velocityMax > spec->velocityMin && spec->zeroRange > 0
+        && spec->maxRange >= spec->step && spec->step > 0
+        && (spec->interpolation == InterpolateLinear
+            || spec->interpolation == InterpolateCubic);
+}
+
+/* Number of doubles in a valid spec's data, or 0 if their size does not
+ * fit in an unsigned long */
+
+static unsigned long gridValues(const struct ballistics_grid_spec *spec,
+    unsigned long rows)
+{
+    unsigned long factor[5], values = 1;
+    int k;
+
+    factor[0] = spec->dragCount;
+    factor[1] = spec->bCCount;
+    factor[2] = spec->velocityCount;
+    factor[3] = rows;
+    factor[4] = GRID_VALUES;
+    for (k = 0; k < 5; k++) {
+        if (values > ULONG_MAX / sizeof(double) / factor[k])
+            return 0;
+        values *= factor[k];
+    }
+    return values;
+}
+
+/* Allocates a grid for a spec, with 'step' already defaulted */
+
+static ballistics_grid_t gridAllocate(const struct ballistics_grid_spec *spec)
+{
+    ballistics_grid_t grid;
+    unsigned long values;
+
+    if (!gridValid(spec))
+        return NULL;
+    values = gridValues(spec, spec->maxRange / spec->step + 1);
+    if (values == 0)
+        return NULL;
+    grid = calloc(1, sizeof(struct ballistics_grid));
+    if (grid == NULL)
+        return NULL;
+    grid->spec = *spec;
+    grid->rows = spec->maxRange / spec->step + 1;
+    grid->dragFunction = malloc(spec->dragCount * sizeof(int));
+    grid->data = malloc(values * sizeof(double));
+    if (grid->dragFunction == NULL || grid->data == NULL) {
+        libballistics_finishGrid(grid);
+        return NULL;
+    }
+    grid->spec.dragFunction = grid->dragFunction;
+    return grid;
+}
+
+ballistics_grid_t libballistics_createGrid(
+    const struct ballistics_grid_spec *spec)
+{
+    struct ballistics_grid_spec layout;
+    struct grid_build build;
+    ballistics_grid_t grid;
+    pthread_t *threads;
+    long online;
+    int count, t, started;
+
+    if (spec == NULL || spec->dragFunction == NULL)
+        return NULL;
+    layout = *spec;
+    if (layout.step == 0)
+        layout.step = GRID_STEP;
+    grid = gridAllocate(&layout);
+    if (grid == NULL)
+        return NULL;
+    memcpy(grid->dragFunction, spec->dragFunction,
+        spec->dragCount * sizeof(int));
+
+    build.grid = grid;
+    build.next = 0;
+    build.nodes = (unsigned long) spec->dragCount * spec->bCCount
+        * spec->velocityCount;
+    count = spec->threads;
+    if (count <= 0) {
+        online = sysconf(_SC_NPROCESSORS_ONLN);
+        count = online > 0 ? (int) online : 1;
+    }
+    threads = calloc(count, sizeof(pthread_t));
+    if (threads == NULL) {
+        libballistics_finishGrid(grid);
+        return NULL;
+    }
+
+    /* The calling thread works too */
+    pthread_mutex_init(&build.lock, NULL);
+    for (t = 1, started = 1; t < count; t++, started++) {
+        if (pthread_create(threads + t, NULL, gridWorker, &build) != 0)
+            break;
+    }
+    gridWorker(&build);
+    for (t = 1; t < started; t++)
+        pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&build.lock);
+    free(threads);
+
+    /* Nodes are only left over if no worker could allocate a context */
+    if (build.next < build.nodes) {
+        libballistics_finishGrid(grid);
+        return NULL;
+    }
+    return grid;
+}
+
+void libballistics_finishGrid(ballistics_grid_t grid) {
+    if (grid == NULL)
+        return;
+    free(grid->dragFunction);
+    free(grid->data);
+    free(grid);
+}
+
+/* Stencil of 'points' nodes (fewer if the axis is shorter) around x, on an
+ * axis of 'count' nodes 'h' apart from 'min', with Lagrange weights */
+
+static void gridAxis(double x, double min, double h, int count, int points,
+    struct grid_axis *axis)
+{
+    double u = (x - min) / h, t;
+    int cell = (int) u, n = points < count ? points : count, k, m;
+
+    if (cell > count - 2)
+        cell = count - 2;
+    axis->start = cell - (n / 2 - 1);
+    if (axis->start > count - n)
+        axis->start = count - n;
+    if (axis->start < 0)
+        axis->start = 0;
+    axis->count = n;
+    t = u - axis->start;
+    for (k = 0; k < n; k++) {
+        axis->w[k] = 1.0;
+        for (m = 0; m < n; m++) {
+            if (m != k)
+                axis->w[k] *= (t - m) / (k - m);
+        }
+    }
+}
+
+/* Weighted sum of pathY, time and lag over a stencil. Returns -1 if the
+ * stencil touches a hole. */
+
+static int gridInterpolate(ballistics_grid_t grid, int model,
+    const struct grid_axis *bC, const struct grid_axis *velocity,
+    const struct grid_axis *range, double *value)
+{
+    const double *node, *row;
+    double w;
+    int a, b, c, q;
+
+    value[0] = value[1] = value[2] = 0;
+    for (a = 0; a < bC->count; a++) {
+        for (b = 0; b < velocity->count; b++) {
+            node = gridNode(grid, model, bC->start + a, velocity->start + b);
+            for (c = 0; c < range->count; c++) {
+                row = node + (range->start + c) * GRID_VALUES;
+                if (row[0] == GRID_HOLE)
+                    return -1;
+                w = bC->w[a] * velocity->w[b] * range->w[c];
+                for (q = 0; q < GRID_VALUES; q++)
+                    value[q] += w * row[q];
+            }
+        }
+    }
+    return 0;
+}
+
+int libballistics_queryGrid(
+    ballistics_grid_t grid,
+    int dragFunction,
+    double bC,
+    double velocity,
+    double range,
+    double crosswind,
+    ballistics_grid_answer_t answer)
+{
+    const struct ballistics_grid_spec *spec = &grid->spec;
+    struct grid_axis axis[2][3];
+    double value[2][GRID_VALUES], *answered, *other;
+    double h, lastRange = (double) (grid->rows - 1) * spec->step;
+    int model, p;
+
+    for (model = 0; model < spec->dragCount; model++) {
+        if (grid->dragFunction[model] == dragFunction)
+            break;
+    }
+    if (model == spec->dragCount)
+        return -1;
+    if (!(bC >= spec->bCMin && bC <= spec->bCMax)
+        || !(velocity >= spec->velocityMin && velocity <= spec->velocityMax)
+        || !(range >= 0 && range <= lastRange))
+        return -1;
+
+    for (p = 0; p < 2; p++) {
+        h = (spec->bCMax - spec->bCMin) / (spec->bCCount - 1);
+        gridAxis(bC, spec->bCMin, h, spec->bCCount, 2 + 2*p, &axis[p][0]);
+        h = (spec->velocityMax - spec->velocityMin)
+            / (spec->velocityCount - 1);
+        gridAxis(velocity, spec->velocityMin, h, spec->velocityCount,
+            2 + 2*p, &axis[p][1]);
+        gridAxis(range, 0, spec->step, grid->rows, 2 + 2*p, &axis[p][2]);
+        if (gridInterpolate(grid, model, &axis[p][0], &axis[p][1],
+            &axis[p][2], value[p]))
+            return -1;
+    }
+
+    answered = value[spec->interpolation == InterpolateCubic];
+    other = value[spec->interpolation != InterpolateCubic];
+    answer->pathY = answered[0];
+    answer->time = answered[1];
+    answer->pathX = crosswind * 17.60 * answered[2];
+    answer->pathYError = fabs(answered[0] - other[0]);
+    answer->timeError = fabs(answered[1] - other[1]);
+    answer->pathXError = fabs(crosswind * 17.60 * (answered[2] - other[2]));
+    return 0;
+}
+
+/* Files: the magic, version and byte order tag, GRID_HEADER doubles
+ * describing the layout, one double per drag function, then the node data
+ * in memory order */
+
+int libballistics_saveGrid(ballistics_grid_t grid, const char *path) {
+    const struct ballistics_grid_spec *spec = &grid->spec;
+    unsigned int tag[2] = { GRID_VERSION, GRID_ENDIAN };
+    double header[GRID_HEADER];
+    unsigned long values;
+    FILE *f;
+    int i, ok;
+
+    /* Drag curve numbers mean nothing to another process */
+    for (i = 0; i < spec->dragCount; i++) {
+        if (grid->dragFunction[i] >= LIBBALLISTICS_DRAG_CURVE)
+            return -1;
+    }
+
+    header[0] = spec->dragCount;
+    header[1] = spec->bCMin;
+    header[2] = spec->bCMax;
+    header[3] = spec->bCCount;
+    header[4] = spec->velocityMin;
+    header[5] = spec->velocityMax;
+    header[6] = spec->velocityCount;
+    header[7] = spec->sightHeight;
+    header[8] = spec->zeroRange;
+    header[9] = spec->maxRange;
+    header[10] = spec->step;
+    header[11] = spec->interpolation;
+    header[12] = grid->rows;
+    values = gridValues(spec, grid->rows);
+
+    f = fopen(path, "wb");
+    if (f == NULL)
+        return -1;
+    ok = fwrite(gridMagic, sizeof(gridMagic), 1, f) == 1
+        && fwrite(tag, sizeof(tag), 1, f) == 1
+        && fwrite(header, sizeof(header), 1, f) == 1;
+    for (i = 0; ok && i < spec->dragCount; i++) {
+        header[0] = grid->dragFunction[i];
+        ok = fwrite(header, sizeof(double), 1, f) == 1;
+    }
+    ok = ok && fwrite(grid->data, sizeof(double), values, f) == values;
+    if (fclose(f) != 0)
+        ok = 0;
+    return ok ? 0 : -1;
+}
+
+/* Whether a header field read from a file is a finite number that fits
+ * the type it is converted to, 0 to 'limit' */
+
+static int headerFits(double value, double limit) {
+    return isfinite(value) && value >= 0 && value <= limit;
+}
+
+ballistics_grid_t libballistics_loadGrid(const char *path) {
+    struct ballistics_grid_spec spec;
+    ballistics_grid_t grid = NULL;
+    unsigned int tag[2];
+    char magic[sizeof(gridMagic)];
+    double header[GRID_HEADER], model;
+    unsigned long values;
+    FILE *f;
+    int i, ok;
+
+    f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+    ok = fread(magic, sizeof(magic), 1, f) == 1
+        && memcmp(magic, gridMagic, sizeof(magic)) == 0
+        && fread(tag, sizeof(tag), 1, f) == 1
+        && tag[0] == GRID_VERSION && tag[1] == GRID_ENDIAN
+        && fread(header, sizeof(header), 1, f) == 1
+        && header[0] >= 1 && header[0] <= 64
+        && isfinite(header[1]) && isfinite(header[2])
+        && headerFits(header[3], INT_MAX)
+        && isfinite(header[4]) && isfinite(header[5])
+        && headerFits(header[6], INT_MAX) && isfinite(header[7])
+        && headerFits(header[8], ULONG_MAX / 2)
+        && headerFits(header[9], ULONG_MAX / 2)
+        && headerFits(header[10], ULONG_MAX / 2)
+        && headerFits(header[11], INT_MAX)
+        && headerFits(header[12], ULONG_MAX / 2);
+
+    if (ok) {
+        memset(&spec, 0, sizeof(spec));
+        spec.dragCount = (int) header[0];
+        spec.bCMin = header[1];
+        spec.bCMax = header[2];
+        spec.bCCount = (int) header[3];
+        spec.velocityMin = header[4];
+        spec.velocityMax = header[5];
+        spec.velocityCount = (int) header[6];
+        spec.sightHeight = header[7];
+        spec.zeroRange = (unsigned long) header[8];
+        spec.maxRange = (unsigned long) header[9];
+        spec.step = (unsigned long) header[10];
+        spec.interpolation = (int) header[11];
+        grid = gridAllocate(&spec);
+        ok = grid != NULL && grid->rows == (unsigned long) header[12];
+    }
+    for (i = 0; ok && i < spec.dragCount; i++) {
+        ok = fread(&model, sizeof(double), 1, f) == 1
+            && headerFits(model, LIBBALLISTICS_DRAG_CURVE - 1);
+        if (ok)
+            grid->dragFunction[i] = (int) model;
+    }
+    if (ok) {
+        values = gridValues(&spec, grid->rows);
+        ok = fread(grid->data, sizeof(double), values, f) == values;
+    }
+    fclose(f);
+    if (!ok) {
+        libballistics_finishGrid(grid);
+        return NULL;
+    }
+    return grid;
+}
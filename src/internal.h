@@ -0,0 +1,340 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Declarations shared between the library's translation units. This header
+ * is not installed; the public interface lives in ballistics.h. */
+
+#ifndef __LIBBALLISTICS_INTERNAL_H__
+#define __LIBBALLISTICS_INTERNAL_H__
+
+#ifdef HAVE_CONFIG_H
+#include "auto-config.h"
+#endif
+#include "ballistics.h"
+
+#define COUNTOF(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Velocity (fps) at and above which the drag functions are undefined */
+#define LIBBALLISTICS_MAX_VELOCITY		10000.0
+
+/* retardation_segment: One piece of a piecewise drag function. Retardation
+ *     is A * pow(v, M) / bC for velocities above 'velocity' (fps). Segments
+ *     are ordered by descending velocity.
+ */
+
+struct retardation_segment {
+    double velocity;
+    double A;
+    double M;
+};
+
+/* libballistics_retardationSegments: returns the segment table used by
+ *     libballistics_computeRetardation for a drag function, and stores the
+ *     number of segments in 'count'. Returns NULL (and a count of zero) for
+ *     drag functions without a retardation model.
+ */
+
+const struct retardation_segment *libballistics_retardationSegments(
+    int dragFunction, int *count);
+
+/* User drag curves, in curves.c. A curve's segments are ordered by
+ * descending velocity like retardation_segment tables, and each gives
+ * Cd = c0 + c1 s + c2 s^2 + c3 s^3 with s the velocity (fps) above its
+ * threshold. The retardation is LIBBALLISTICS_CURVE_K * Cd * v^2 / bC,
+ * K being pi/8 times standard air density (lb/ft^3) over 144 in^2/ft^2.
+ * libballistics_dragCurve returns NULL for drag functions that are not
+ * registered curves. libballistics_curveIndex finds the segment for a
+ * velocity through the curve's bucket index, without a cursor;
+ * libballistics_curveRetardation walks from the segment at 'index' as
+ * libballistics_computeCursorRetardation does.
+ */
+
+#define LIBBALLISTICS_CURVE_K   (M_PI / 8 * 0.0764742 / 144)
+
+struct curve_segment {
+    double velocity;
+    double c[4];
+};
+
+struct drag_curve {
+    int id;
+    int count;
+    struct curve_segment *segments;
+    int *index;
+    int buckets;
+    double bucketScale;     /* Buckets per fps */
+};
+
+#define libballistics_curveCd(segment, v) \
+    ((segment)->c[0] + ((v) - (segment)->velocity) * ((segment)->c[1] \
+        + ((v) - (segment)->velocity) * ((segment)->c[2] \
+        + ((v) - (segment)->velocity) * (segment)->c[3])))
+
+const struct drag_curve *libballistics_dragCurve(int dragFunction);
+int libballistics_curveIndex(const struct drag_curve *curve, double velocity);
+double libballistics_curveRetardation(const struct drag_curve *curve,
+    int *index, double bC, double velocity);
+
+/* Instruction set for the vectorized kernels, in dispatch.c; as
+ * libballistics_getSimdLevel */
+
+int libballistics_simdLevel(void);
+
+/* Ballistic coefficient selection used by the solvers, in solve.c */
+
+double libballistics_getBallisticCoefficient(ballistics_ctx_t context,
+    double velocity);
+double libballistics_getBallisticCoefficientForLowestVelocity(
+    ballistics_ctx_t context);
+
+/* Compiled drag schedules, in schedule.c. libballistics_compileSchedule
+ * merges the context's ballistic coefficients with a drag function's
+ * segments into context->schedule for a solve with the given headwind; it
+ * returns -1 if it cannot allocate the table. A schedule_cursor then
+ * evaluates it along a trajectory: libballistics_scheduleRetardation takes
+ * the projectile's speed over the ground, stores the ballistic coefficient
+ * in effect at 'bC' and returns the retardation, as the solvers compute it
+ * from libballistics_getBallisticCoefficient and a retardation cursor. A
+ * coefficient of zero means there is none and the flight must stop.
+ * libballistics_scheduleExponent then gives the exponent M of the drag
+ * segment that lookup used (for drag curves, the local exponent
+ * d ln(retardation) / d ln(v)), or 0 where the retardation was constant.
+ */
+
+struct schedule_entry {
+    double velocity;    /* Lower threshold, speed through the air (fps) */
+    double A;           /* Segment coefficient divided by bC */
+    double M;
+    double bC;          /* Zero where no band applies */
+    const struct curve_segment *curve;  /* For drag curves, A * Cd * v^2 */
+};
+
+struct schedule_cursor {
+    ballistics_ctx_t context;
+    const struct schedule_entry *entries;
+    int count;
+    int index;
+    int band;           /* Entry giving the band, with an atmosphere table */
+    double headwind;
+    double lastBc;
+    unsigned long switches;
+    struct retardation_cursor drag;
+    const struct atmosphere_table *air;
+    double density;     /* Retardation factor for the air at the projectile */
+    double sound;       /* Standard over local speed of sound */
+};
+
+int libballistics_compileSchedule(ballistics_ctx_t context, int dragFunction,
+    double headwind);
+void libballistics_initSchedule(struct schedule_cursor *cursor,
+    ballistics_ctx_t context, int dragFunction, double headwind);
+double libballistics_scheduleRetardation(struct schedule_cursor *cursor,
+    double velocity, double *bC);
+double libballistics_scheduleExponent(const struct schedule_cursor *cursor,
+    double velocity);
+
+/* Atmospheres along the flight, in atmosphere.c. With AtmosphereStandard,
+ * libballistics_atmosphereTable fills the context's table for a solve
+ * along 'losAngle' out to 'maxRange' yards and returns it; otherwise it
+ * returns NULL. Rows are a fixed distance apart in height above the
+ * muzzle and hold the two factors a schedule_cursor applies: the density
+ * ratio times the square of the speed of sound ratio, which scales the
+ * retardation, and the inverse speed of sound ratio, which scales the
+ * airspeed to the Mach number the drag function expects. Both are relative
+ * to the standard conditions the drag functions are defined at.
+ * libballistics_scheduleAltitude interpolates them at the solver's state
+ * (x, y) (feet) into the cursor; cursors without a table keep factors of 1.
+ */
+
+#define ATMOSPHERE_ROWS     33
+
+struct atmosphere_table {
+    double sinLos, cosLos;
+    double base;        /* Height of the first row above the muzzle (feet) */
+    double scale;       /* Rows per foot */
+    double rows[ATMOSPHERE_ROWS][2];
+};
+
+const struct atmosphere_table *libballistics_atmosphereTable(
+    ballistics_ctx_t context, double losAngle, unsigned long maxRange);
+void libballistics_scheduleAltitude(struct schedule_cursor *cursor,
+    double x, double y);
+
+/* libballistics_reserveTrajectory: makes room for 'rows' rows in the
+ *     context's trajectory buffer. Internal buffers only ever grow; a
+ *     caller-supplied buffer that is too small fails, and a viewed card is
+ *     let go for a buffer of the context's own. Returns 0, or -1 on
+ *     failure. Row contents are not initialized.
+ */
+
+int libballistics_reserveTrajectory(ballistics_ctx_t context,
+    unsigned long rows);
+
+/* libballistics_tableRows: number of valid rows in the context's trajectory
+ *     table, from its terminating row. Zero without a table. In retrieve.c.
+ */
+
+unsigned long libballistics_tableRows(ballistics_ctx_t context);
+
+/* Sampled output, in output.c. libballistics_outputBegin validates an
+ * output for a table of 'rows' rows (ranges 0 to rows - 1) and resets it;
+ * it returns -1 if the output is unusable. Rows are then passed in range
+ * order, either as a finished row or as the solver state the row would be
+ * computed from, and the wanted ones are stored or passed to the output's
+ * callback. Both return nonzero once the callback asks to stop.
+ */
+
+int libballistics_outputBegin(ballistics_output_t output, unsigned long rows);
+int libballistics_outputRow(ballistics_output_t output,
+    const struct trajectory_path *row, unsigned long n);
+int libballistics_outputState(ballistics_output_t output, unsigned long n,
+    double x, double y, double t, double v, double vx, double vy,
+    double crosswind, double velocity);
+
+/* libballistics_computeTrajectoryAdaptive: libballistics_computeTrajectory
+ *     for contexts using AdaptiveIntegrator. Takes the same arguments.
+ */
+
+int libballistics_computeTrajectoryAdaptive(ballistics_ctx_t context,
+    int dragFunction, double velocity, double sightHeight, double losAngle,
+    double zeroAngle, double windVelocity, double windAngle,
+    unsigned long maxRange);
+
+/* Trajectory sensitivities, in sensitivity.c. A solver computing them keeps
+ * a tangent_model and, next to its state, TANGENT_SIZE tangents: the
+ * derivatives of x, y, vx and vy (feet, fps) with respect to parameter p at
+ * T[4*p] to T[4*p + 3]. libballistics_tangentStart sets up both for a
+ * solve evaluating drag through 'schedule';
+ * libballistics_tangentDerivative gives the tangents' time derivatives at
+ * state s from the retardation dv the schedule returned there.
+ * libballistics_tangentCross is called at each state the solver accepts,
+ * after the schedule has evaluated it, and corrects T where the drag
+ * segment or coefficient band has changed since the previous one,
+ * returning 1 if it did. libballistics_tangentRecord turns the tangents
+ * into a sensitivity row for the range x (feet) reached at time t.
+ * libballistics_tangentStep advances them as the fixed step solver advances
+ * its state: velocity by Euler's method, position by the mean velocity.
+ */
+
+#define TANGENT_SIZE    (4 * ParameterCount)
+
+struct tangent_model {
+    const struct schedule_cursor *schedule;
+    int segment;
+    double dv, airspeed, exponent;
+    double velocity;
+    double bC;
+    double headwind, crosswind;
+    double headwindRate, crosswindRate;
+    double Gx, Gy;
+    double k;
+};
+
+void libballistics_tangentStart(struct tangent_model *model,
+    ballistics_ctx_t context, const struct schedule_cursor *schedule,
+    double velocity, double zeroAngle, double windVelocity, double windAngle,
+    double Gx, double Gy, double *T);
+void libballistics_tangentDerivative(const struct tangent_model *model,
+    const double *s, double dv, const double *T, double *dT);
+int libballistics_tangentCross(struct tangent_model *model, const double *s,
+    double dv, double *T);
+void libballistics_tangentRecord(const struct tangent_model *model,
+    ballistics_sensitivity_t row, double x, double t, double vx, double vy,
+    const double *T);
+void libballistics_tangentStep(double *T, const double *dT, double dt);
+
+/* Event detection, in events.c. A solver watching for events passes each
+ * step to libballistics_eventsStep with the state at both ends (feet,
+ * seconds, fps) and a function giving the state at fraction theta of the
+ * step, or NULL to interpolate linearly between the ends. */
+
+struct event_state {
+    double x, y, vx, vy, t;
+};
+
+typedef void (*event_interpolant)(const void *arg, double theta,
+    struct event_state *state);
+
+void libballistics_eventsBegin(ballistics_events_t events);
+void libballistics_eventsStep(ballistics_events_t events,
+    const struct event_state *from, const struct event_state *to,
+    event_interpolant at, const void *arg);
+
+/* Canonical shot keys, in cache.c, shared by the solution cache and card
+ * files. A key is the words of every input that can change a solution, in a
+ * fixed order; libballistics_hashKey is 64-bit FNV-1a over them. */
+
+#define SHOT_KEY_HEADER     18      /* Key words before the bands */
+
+enum CacheKind {
+    CacheZero=1,
+    CacheTrajectory
+};
+
+unsigned long libballistics_shotKeyLength(const struct ballistics_shot *shot,
+    int kind);
+void libballistics_shotKey(const struct ballistics_shot *shot, int kind,
+    double zeroRange, double yIntercept, double *key);
+unsigned long long libballistics_hashKey(const double *key,
+    unsigned long length);
+
+/* Solver statistics, in stats.c. A solver keeps a solve_stats for each
+ * solve: it counts into it with LIBBALLISTICS_STAT, marks the end of each
+ * phase with libballistics_statsPhase and hands the totals to the context
+ * with libballistics_statsEnd. Without LIBBALLISTICS_STATS all of it
+ * compiles away; LIBBALLISTICS_STAT then leaves its expression unevaluated
+ * under sizeof, which still checks it and references the counters, so a
+ * solve_stats pointer a solver only counts into raises no warning.
+ */
+
+struct solve_stats {
+    double time;
+    unsigned long long hardware[3];
+    unsigned long steps;
+    unsigned long retardations;
+    unsigned long bcLookups;
+    unsigned long bandSwitches;
+    unsigned long iterations;
+    int zero;
+};
+
+#ifdef LIBBALLISTICS_STATS
+
+#define LIBBALLISTICS_STAT(expression)  (expression)
+
+void libballistics_statsBegin(ballistics_ctx_t context,
+    struct solve_stats *stats);
+void libballistics_statsPhase(ballistics_ctx_t context,
+    struct solve_stats *stats, int phase);
+void libballistics_statsEnd(ballistics_ctx_t context,
+    struct solve_stats *stats);
+void libballistics_statsClose(ballistics_ctx_t context);
+
+#else
+
+#define LIBBALLISTICS_STAT(expression)  ((void) sizeof (expression))
+#define libballistics_statsBegin(context, stats)            ((void) (stats))
+#define libballistics_statsPhase(context, stats, phase)     ((void) (stats))
+#define libballistics_statsEnd(context, stats)              ((void) (stats))
+#define libballistics_statsClose(context)                   ((void) 0)
+
+#endif
+
+#endif /* __LIBBALLISTICS_INTERNAL_H__ */
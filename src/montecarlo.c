@@ -0,0 +1,407 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Monte Carlo hit probability.
+ *
+ * Samples are simulated in blocks of MC_BLOCK. Block b draws from its own
+ * xoshiro256** stream, seeded by splitmix64 from the seed and b, and every
+ * sample draws the same number of variates whatever the spreads, so a
+ * sample's shot depends only on the seed and its index. Blocks are handed
+ * out to threads in rounds of MC_ROUND; each block's sums are kept apart
+ * and added up in block order at the end of the round, where the stopping
+ * rule is checked. Thread count therefore changes the speed and nothing
+ * else.
+ *
+ * Each shot is solved into a sampled output holding just the two rows
+ * around its true range, so the solver stops there and keeps no table. */
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include "internal.h"
+
+#define MC_BLOCK        256
+#define MC_ROUND        16      /* Blocks per round */
+#define MC_VARIATES     7
+
+/* Two sided 95% normal quantile */
+#define MC_Z            1.959964
+
+struct mc_rng {
+    unsigned long long s[4];
+};
+
+/* Sums over the shots of one block */
+
+struct mc_block {
+    unsigned long samples, hits, reached;
+    double x, y, xx, yy;
+};
+
+struct mc_job {
+    const struct ballistics_shot *shot;
+    const struct ballistics_dispersion *dispersion;
+    double aimX, aimY;
+    struct mc_block *blocks;
+    unsigned long first, count;     /* Blocks of this round */
+    unsigned long next;
+    pthread_mutex_t lock;
+};
+
+struct mc_worker {
+    struct mc_job *job;
+    ballistics_ctx_t context;
+    double *bC;
+    pthread_t thread;
+};
+
+static unsigned long long splitmix64(unsigned long long *x) {
+    unsigned long long z = (*x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static unsigned long long rotl(unsigned long long x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static void rngSeed(struct mc_rng *rng, unsigned long long seed,
+    unsigned long block)
+{
+    unsigned long long x;
+    int i;
+
+    /* splitmix64 advances seed; mix in the advanced value, in its own
+     * statement so the order does not depend on the compiler */
+    x = splitmix64(&seed) * (block + 1);
+    x ^= seed;
+    for (i = 0; i < 4; i++)
+        rng->s[i] = splitmix64(&x);
+}
+
+/* xoshiro256** */
+
+static unsigned long long rngNext(struct mc_rng *rng) {
+    unsigned long long *s = rng->s;
+    unsigned long long result = rotl(s[1] * 5, 7) * 9;
+    unsigned long long t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+/* Uniform on (0, 1] */
+
+static double rngUniform(struct mc_rng *rng) {
+    return ((rngNext(rng) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/* Standard normal variates, by pairs (Box-Muller) */
+
+static void rngNormal(struct mc_rng *rng, double *z, int count) {
+    double r, a;
+    int i;
+
+    for (i = 0; i < count; i += 2) {
+        r = sqrt(-2 * log(rngUniform(rng)));
+        a = 2 * M_PI * rngUniform(rng);
+        z[i] = r * cos(a);
+        if (i + 1 < count)
+            z[i + 1] = r * sin(a);
+    }
+}
+
+/* Solves a shot out to 'range' yards and interpolates its path there.
+ * Returns 0, or -1 if the flight does not get that far. */
+
+static int mcImpact(ballistics_ctx_t context,
+    const struct ballistics_shot *shot, const double *bC, double velocity,
+    double windVelocity, double windAngle, double range, double *pathX,
+    double *pathY)
+{
+    struct ballistics_output output;
+    unsigned long ranges[2], i;
+    double r[2], x[2], y[2], f;
+
+    libballistics_reset(context);
+    for (i = 0; i < shot->bcCount; i++) {
+        if (libballistics_addBallisticCoefficient(context, bC[i],
+            shot->minFPS ? shot->minFPS[i] : 0,
+            shot->maxFPS ? shot->maxFPS[i] : 0))
+            return -1;
+    }
+    if (libballistics_setIntegrator(context, shot->integrator,
+        shot->tolerance))
+        return -1;
+
+    memset(&output, 0, sizeof(output));
+    ranges[0] = (unsigned long) range;
+    ranges[1] = ranges[0] + 1;
+    output.ranges = ranges;
+    output.rangeCount = 2;
+    output.columns = LIBBALLISTICS_COLUMN(ColumnRange)
+        | LIBBALLISTICS_COLUMN(ColumnPathX)
+        | LIBBALLISTICS_COLUMN(ColumnPathY);
+    output.precision = OutputDouble;
+    output.column[ColumnRange] = r;
+    output.column[ColumnPathX] = x;
+    output.column[ColumnPathY] = y;
+    output.capacity = 2;
+    libballistics_setOutput(context, &output);
+    libballistics_computeTrajectory(context, shot->dragFunction, velocity,
+        shot->sightHeight, shot->losAngle, shot->zeroAngle, windVelocity,
+        windAngle, ranges[1]);
+    libballistics_setOutput(context, NULL);
+    if (output.samples < 2 || !(r[1] > r[0]))
+        return -1;
+
+    /* Fixed step rows lie just past their yard, so interpolate by the
+     * ranges actually reached */
+    f = (range - r[0]) / (r[1] - r[0]);
+    *pathX = x[0] + f * (x[1] - x[0]);
+    *pathY = y[0] + f * (y[1] - y[0]);
+    return 0;
+}
+
+/* Coefficients of the shot for a sample, atmosphere applied */
+
+static void mcCoefficients(const struct ballistics_shot *shot, double scale,
+    double *bC)
+{
+    unsigned long i;
+
+    for (i = 0; i < shot->bcCount; i++) {
+        bC[i] = shot->bC[i] * scale;
+        if (shot->atmosphere)
+            bC[i] = libballistics_applyAtmosphere(bC[i], shot->altitude,
+                shot->barometricPressure, shot->temperature,
+                shot->relativeHumidity);
+    }
+}
+
+static void mcSimulate(struct mc_worker *w, unsigned long block) {
+    const struct mc_job *job = w->job;
+    const struct ballistics_shot *shot = job->shot;
+    const struct ballistics_dispersion *d = job->dispersion;
+    struct mc_block *sums = job->blocks + (block - job->first);
+    struct mc_rng rng;
+    unsigned long i, end = (block + 1) * MC_BLOCK;
+    double z[MC_VARIATES + 1], scale, velocity, range, moa, x, y, u, v;
+
+    if (end > d->samples)
+        end = d->samples;
+    memset(sums, 0, sizeof(*sums));
+    rngSeed(&rng, d->seed, block);
+
+    for (i = block * MC_BLOCK; i < end; i++) {
+        rngNormal(&rng, z, MC_VARIATES);
+        sums->samples++;
+
+        velocity = shot->velocity + d->velocity * z[0];
+        scale = 1 + d->bC * z[1];
+        range = d->range + d->rangeError * z[4];
+        if (!(velocity > 0) || !(scale > 0) || !(range > 0))
+            continue;
+        mcCoefficients(shot, scale, w->bC);
+        if (mcImpact(w->context, shot, w->bC, velocity,
+            shot->windVelocity + d->windVelocity * z[2],
+            shot->windAngle + d->windAngle * z[3], range, &x, &y))
+            continue;
+
+        /* Held for the nominal impact at the estimated range, with the
+         * aim line scaling with the true one. 'moa' is an MOA in inches at
+         * the true range. */
+        moa = libballistics_moa2rad(1.0) * range * 36;
+        x += d->precision * moa * z[5] - job->aimX * range / d->range;
+        y += d->precision * moa * z[6] - job->aimY * range / d->range;
+        sums->reached++;
+        sums->x += x;
+        sums->y += y;
+        sums->xx += x * x;
+        sums->yy += y * y;
+
+        u = x / (d->targetWidth / 2);
+        v = y / (d->targetHeight / 2);
+        if (d->roundTarget ? u*u + v*v <= 1 : fabs(u) <= 1 && fabs(v) <= 1)
+            sums->hits++;
+    }
+}
+
+static void *mcWorker(void *arg) {
+    struct mc_worker *w = arg;
+    struct mc_job *job = w->job;
+    unsigned long block;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        block = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (block >= job->first + job->count)
+            break;
+        mcSimulate(w, block);
+    }
+    return NULL;
+}
+
+/* Wilson score interval for 'hits' out of 'n' */
+
+static void mcInterval(unsigned long hits, unsigned long n, double *lower,
+    double *upper)
+{
+    double p = (double) hits / n, z2n = MC_Z * MC_Z / n;
+    double centre = (p + z2n / 2) / (1 + z2n);
+    double half = MC_Z * sqrt(p * (1 - p) / n + z2n / (4 * n)) / (1 + z2n);
+
+    *lower = centre - half > 0 ? centre - half : 0;
+    *upper = centre + half < 1 ? centre + half : 1;
+}
+
+/* Simulates rounds of blocks until the samples run out or the interval is
+ * narrow enough. Returns -1 if the nominal shot misses the range. */
+
+static int mcRun(struct mc_job *job, struct mc_worker *workers, int threads,
+    unsigned long blocks, ballistics_hit_t hit)
+{
+    const struct ballistics_shot *shot = job->shot;
+    const struct ballistics_dispersion *dispersion = job->dispersion;
+    struct mc_block total;
+    unsigned long b;
+    double x, y;
+    int t, started;
+
+    /* The point of aim: the nominal shot at the estimated range */
+    mcCoefficients(shot, 1, workers[0].bC);
+    if (mcImpact(workers[0].context, shot, workers[0].bC, shot->velocity,
+        shot->windVelocity, shot->windAngle, dispersion->range, &x, &y))
+        return -1;
+    job->aimX = x;
+    job->aimY = y;
+
+    memset(&total, 0, sizeof(total));
+    for (job->first = 0; job->first < blocks; job->first += job->count) {
+        job->count = blocks - job->first < MC_ROUND ? blocks - job->first
+            : MC_ROUND;
+        job->next = job->first;
+
+        /* The calling thread is worker 0 */
+        started = 1;
+        for (t = 1; t < threads; t++) {
+            if (pthread_create(&workers[t].thread, NULL, mcWorker,
+                workers + t) != 0)
+                break;
+            started++;
+        }
+        mcWorker(workers);
+        for (t = 1; t < started; t++)
+            pthread_join(workers[t].thread, NULL);
+
+        for (b = 0; b < job->count; b++) {
+            total.samples += job->blocks[b].samples;
+            total.hits += job->blocks[b].hits;
+            total.reached += job->blocks[b].reached;
+            total.x += job->blocks[b].x;
+            total.y += job->blocks[b].y;
+            total.xx += job->blocks[b].xx;
+            total.yy += job->blocks[b].yy;
+        }
+        mcInterval(total.hits, total.samples, &hit->lower, &hit->upper);
+        if (dispersion->tolerance > 0
+            && hit->upper - hit->lower <= 2 * dispersion->tolerance)
+            break;
+    }
+
+    hit->samples = total.samples;
+    hit->hits = total.hits;
+    hit->probability = (double) total.hits / total.samples;
+    hit->reached = total.reached;
+    if (total.reached > 0) {
+        hit->meanX = total.x / total.reached;
+        hit->meanY = total.y / total.reached;
+    }
+    if (total.reached > 1) {
+        x = (total.xx - total.x * hit->meanX) / (total.reached - 1);
+        y = (total.yy - total.y * hit->meanY) / (total.reached - 1);
+        hit->sdX = x > 0 ? sqrt(x) : 0;
+        hit->sdY = y > 0 ? sqrt(y) : 0;
+    }
+    return 0;
+}
+
+int libballistics_computeHitProbability(
+    const struct ballistics_shot *shot,
+    const struct ballistics_dispersion *dispersion,
+    ballistics_hit_t hit)
+{
+    struct mc_job job;
+    struct mc_worker *workers;
+    unsigned long blocks;
+    long online;
+    int threads, t, ready, result = -1;
+
+    if (shot == NULL || dispersion == NULL || hit == NULL)
+        return -1;
+    if (shot->bcCount == 0 || dispersion->samples == 0
+        || !(dispersion->range > 0) || !(dispersion->targetWidth > 0)
+        || !(dispersion->targetHeight > 0))
+        return -1;
+    memset(hit, 0, sizeof(*hit));
+
+    blocks = (dispersion->samples + MC_BLOCK - 1) / MC_BLOCK;
+    threads = dispersion->threads;
+    if (threads <= 0) {
+        online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int) online : 1;
+    }
+    if ((unsigned long) threads > blocks)
+        threads = (int) blocks;
+
+    job.shot = shot;
+    job.dispersion = dispersion;
+    job.blocks = calloc(MC_ROUND, sizeof(struct mc_block));
+    workers = calloc(threads, sizeof(struct mc_worker));
+    ready = job.blocks != NULL && workers != NULL;
+    for (t = 0; ready && t < threads; t++) {
+        workers[t].job = &job;
+        workers[t].context = libballistics_create();
+        workers[t].bC = calloc(shot->bcCount, sizeof(double));
+        ready = workers[t].context != NULL && workers[t].bC != NULL;
+    }
+
+    if (ready) {
+        pthread_mutex_init(&job.lock, NULL);
+        result = mcRun(&job, workers, threads, blocks, hit);
+        pthread_mutex_destroy(&job.lock);
+    }
+
+    for (t = 0; workers && t < threads; t++) {
+        libballistics_finish(workers[t].context);
+        free(workers[t].bC);
+    }
+    free(workers);
+    free(job.blocks);
+    return result;
+}
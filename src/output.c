@@ -0,0 +1,176 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#include "internal.h"
+
+/* Sampled Output */
+
+int libballistics_setOutput(
+    ballistics_ctx_t context,
+    ballistics_output_t output)
+{
+    /* The table is not kept while an output is attached; drop it so the
+     * retrieval functions cannot return a stale one */
+    if (output != NULL) {
+        if (!context->external)
+            free(context->trajectory);
+        context->trajectory = NULL;
+        context->capacity = 0;
+        context->external = 0;
+        context->readonly = 0;
+        context->maxValidRange = 0;
+    }
+    context->output = output;
+    return 0;
+}
+
+int libballistics_outputBegin(ballistics_output_t output, unsigned long rows) {
+    unsigned long step = output->step ? output->step : 1;
+    unsigned long needed, i;
+    int c;
+
+    if (output->columns == 0 || (output->columns & ~LIBBALLISTICS_ALL_COLUMNS))
+        return -1;
+    if (output->callback) {
+        output->samples = 0;
+        output->next = 0;
+        return 0;
+    }
+    if (output->precision != OutputDouble && output->precision != OutputFloat)
+        return -1;
+    for (c = 0; c < ColumnCount; c++) {
+        if ((output->columns & LIBBALLISTICS_COLUMN(c))
+            && output->column[c] == NULL)
+            return -1;
+    }
+
+    if (output->ranges) {
+        for (i = 1; i < output->rangeCount; i++) {
+            if (output->ranges[i] < output->ranges[i - 1])
+                return -1;
+        }
+        needed = output->rangeCount;
+    } else {
+        needed = rows ? (rows - 1) / step + 1 : 0;
+    }
+    if (needed > output->capacity)
+        return -1;
+
+    output->samples = 0;
+    output->next = 0;
+    return 0;
+}
+
+/* Number of times row n is sampled: zero or one by step, and once per
+ * matching entry of a range list */
+
+static unsigned long outputWanted(ballistics_output_t output, unsigned long n)
+{
+    unsigned long count = 0;
+
+    if (output->ranges == NULL)
+        return n % (output->step ? output->step : 1) == 0;
+
+    while (output->next < output->rangeCount
+           && output->ranges[output->next] < n)
+        output->next++;
+    while (output->next + count < output->rangeCount
+           && output->ranges[output->next + count] == n)
+        count++;
+    output->next += count;
+    return count;
+}
+
+/* Stores or streams a sample 'count' times. Returns nonzero once the
+ * callback asks to stop. */
+
+static int outputStore(ballistics_output_t output, const double *values,
+    unsigned long count)
+{
+    unsigned long s;
+    int c;
+
+    for (; count > 0; count--) {
+        s = output->samples++;
+        if (output->callback) {
+            if (output->callback(output->arg, values, s))
+                return 1;
+            continue;
+        }
+        for (c = 0; c < ColumnCount; c++) {
+            if (!(output->columns & LIBBALLISTICS_COLUMN(c)))
+                continue;
+            if (output->precision == OutputFloat)
+                ((float *) output->column[c])[s] = (float) values[c];
+            else
+                ((double *) output->column[c])[s] = values[c];
+        }
+    }
+    return 0;
+}
+
+int libballistics_outputRow(ballistics_output_t output,
+    const struct trajectory_path *row, unsigned long n)
+{
+    unsigned long count = outputWanted(output, n);
+    double values[ColumnCount];
+
+    if (count == 0)
+        return 0;
+
+    values[ColumnRange] = row->range;
+    values[ColumnPathY] = row->pathY;
+    values[ColumnPathX] = row->pathX;
+    values[ColumnElevation] = row->elevation;
+    values[ColumnWindage] = row->windage;
+    values[ColumnTime] = row->time;
+    values[ColumnVelocity] = row->velocity;
+    values[ColumnVelocityX] = row->velocityX;
+    values[ColumnVelocityY] = row->velocityY;
+    return outputStore(output, values, count);
+}
+
+int libballistics_outputState(ballistics_output_t output, unsigned long n,
+    double x, double y, double t, double v, double vx, double vy,
+    double crosswind, double velocity)
+{
+    unsigned int columns = output->columns;
+    unsigned long count = outputWanted(output, n);
+    double values[ColumnCount];
+
+    if (count == 0)
+        return 0;
+
+    /* Same expressions as the solvers' tables, computed only when wanted */
+    values[ColumnRange] = x / 3;
+    values[ColumnPathY] = y * 12;
+    if (columns & (LIBBALLISTICS_COLUMN(ColumnPathX)
+                   | LIBBALLISTICS_COLUMN(ColumnWindage)))
+        values[ColumnPathX] = libballistics_computeWindage(crosswind,
+            velocity, x, t);
+    if (columns & LIBBALLISTICS_COLUMN(ColumnElevation))
+        values[ColumnElevation] = libballistics_rad2moa(atan(y/x));
+    if (columns & LIBBALLISTICS_COLUMN(ColumnWindage))
+        values[ColumnWindage] = values[ColumnPathX] * 95.5 / (x / 3);
+    values[ColumnTime] = t;
+    values[ColumnVelocity] = v;
+    values[ColumnVelocityX] = vx;
+    values[ColumnVelocityY] = vy;
+    return outputStore(output, values, count);
+}
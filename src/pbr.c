@@ -0,0 +1,204 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Maximum point blank range.
+ *
+ * Raising the bore lifts the whole trajectory, which pushes the far point
+ * where it falls out of the vital zone further out, until its apex leaves
+ * the zone. So the best zero is the one whose apex sits exactly on the top
+ * of the zone, and the search is for that angle alone: each trial is one
+ * flight that notes the apex and the crossings of the line of sight and
+ * the bottom of the zone as it goes, and stops at the far limit. The
+ * flights step a foot at a time as the zero solvers do, and events are
+ * interpolated within the step they fall in. */
+
+#include <string.h>
+#include "internal.h"
+
+/* Residuals below this (inches) count as converged */
+#define PBR_TOLERANCE       1e-4
+#define PBR_MAX_ITERATIONS  20
+
+/* Range (yards) the atmosphere table is built for */
+#define PBR_AIR_RANGE       100
+
+/* Events of one flight, in feet */
+
+struct pbr_flight {
+    double apexRange, apexHeight;
+    double nearZero, farZero;
+    double nearLimit, farLimit;
+};
+
+/* Flies 'angle' radians until the path falls below 'floor' feet after its
+ * apex. Returns -1 if it never gets there. */
+
+static int pbrFlight(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double velocity,
+    double sightHeight,
+    double floor,
+    double angle,
+    const struct atmosphere_table *air,
+    struct pbr_flight *f,
+    struct solve_stats *stats)
+{
+    struct schedule_cursor schedule;
+    double x = 0, y = -sightHeight/12, x1, y1;
+    double vx = velocity*cos(angle), vy = velocity*sin(angle);
+    double vx1, vy1, v, dt, dv, bC, share;
+    double Gx = LIBBALLISTICS_GRAVITY*sin(angle);
+    double Gy = LIBBALLISTICS_GRAVITY*cos(angle);
+    int apex = 0;
+
+    libballistics_initSchedule(&schedule, context, dragFunction, 0);
+    schedule.air = air;
+    f->apexRange = f->apexHeight = 0;
+    f->nearZero = f->farZero = f->nearLimit = f->farLimit = 0;
+    if (y < floor)
+        f->nearLimit = -1;
+    if (y < 0)
+        f->nearZero = -1;
+
+    for (;;) {
+        vx1 = vx;
+        vy1 = vy;
+        v = sqrt(vx*vx + vy*vy);
+        if (v <= 0.0)
+            return -1;
+        dt = 1/v;
+        LIBBALLISTICS_STAT(stats->steps++);
+
+        if (air)
+            libballistics_scheduleAltitude(&schedule, x, y);
+        dv = libballistics_scheduleRetardation(&schedule, v, &bC);
+        if (bC == 0.0)
+            return -1;
+        LIBBALLISTICS_STAT(stats->retardations++);
+        LIBBALLISTICS_STAT(stats->bcLookups++);
+        vx = vx - dv*vx/v*dt + dt*Gx;
+        vy = vy - dv*vy/v*dt + dt*Gy;
+
+        x1 = x + dt*(vx+vx1)/2;
+        y1 = y + dt*(vy+vy1)/2;
+
+        if (f->nearLimit < 0 && y1 >= floor)
+            f->nearLimit = x + (x1 - x) * (floor - y) / (y1 - y);
+        if (f->nearZero < 0 && y1 >= 0)
+            f->nearZero = x + (x1 - x) * (0 - y) / (y1 - y);
+        if (!apex && vy <= 0) {
+            /* vy is linear over the step, so the rise to its zero is
+             * the area of a triangle */
+            share = vy1 / (vy1 - vy);
+            f->apexRange = x + (x1 - x) * share;
+            f->apexHeight = y + vy1 * share * dt / 2;
+            apex = 1;
+        }
+        if (apex && f->nearZero >= 0 && f->farZero == 0 && y >= 0
+            && y1 < 0)
+            f->farZero = x + (x1 - x) * y / (y - y1);
+        if (apex && y1 < floor) {
+            f->farLimit = y < floor ? x
+                : x + (x1 - x) * (y - floor) / (y - y1);
+            break;
+        }
+        x = x1;
+        y = y1;
+
+        if (vx <= 0.0 || vy > 3*vx)
+            return -1;
+    }
+    LIBBALLISTICS_STAT(stats->bandSwitches += schedule.switches);
+    return 0;
+}
+
+int libballistics_solveMaxPBR(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double velocity,
+    double sightHeight,
+    double vitalZoneRadius,
+    ballistics_pbr_t pbr)
+{
+    const struct atmosphere_table *air;
+    struct solve_stats stats;
+    struct pbr_flight f;
+    double radius = vitalZoneRadius/12;
+    double g = -LIBBALLISTICS_GRAVITY;
+    double lift, angle0, angle1, angle, r0, r1;
+    int iterations = 0, result = -1;
+
+    memset(pbr, 0, sizeof(struct ballistics_pbr));
+    if (context->bCs == NULL || !(velocity > 0) || !(vitalZoneRadius > 0))
+        return -1;
+    libballistics_statsBegin(context, &stats);
+    LIBBALLISTICS_STAT(stats.zero = 1);
+    if (libballistics_compileSchedule(context, dragFunction, 0))
+        return -1;
+
+    /* Flights stay within the vital zone of the line of sight until they
+     * stop, so one table of the context's air serves them all */
+    air = libballistics_atmosphereTable(context, 0, PBR_AIR_RANGE);
+
+    /* In a vacuum the apex rises vy^2 / 2g above the muzzle. Drag lowers
+     * it a little, and the rate below, d(apex)/d(angle) = v^2 sin cos / g,
+     * gives the Newton step for the first update; the secant through the
+     * last two flights takes over from there. */
+    lift = sqrt(2*g*(radius + sightHeight/12)) / velocity;
+    angle0 = asin(lift < 1 ? lift : 1);
+    iterations++;
+    if (pbrFlight(context, dragFunction, velocity, sightHeight, -radius,
+        angle0, air, &f, &stats) == 0) {
+        r0 = f.apexHeight - radius;
+        angle1 = angle0 - r0*g / (velocity*velocity
+            * sin(angle0)*cos(angle0));
+        for (;;) {
+            iterations++;
+            if (pbrFlight(context, dragFunction, velocity, sightHeight,
+                -radius, angle1, air, &f, &stats))
+                break;
+            r1 = f.apexHeight - radius;
+            if (fabs(r1*12) < PBR_TOLERANCE) {
+                result = 0;
+                break;
+            }
+            /* A stalled secant leaves the apex off the vital zone */
+            if (r1 == r0 || iterations >= PBR_MAX_ITERATIONS)
+                break;
+            angle = angle1 - r1*(angle1 - angle0)/(r1 - r0);
+            angle0 = angle1;
+            r0 = r1;
+            angle1 = angle;
+        }
+        pbr->angle = libballistics_rad2deg(angle1);
+        pbr->nearZero = f.nearZero / 3;
+        pbr->farZero = f.farZero / 3;
+        pbr->apexRange = f.apexRange / 3;
+        pbr->apexHeight = f.apexHeight * 12;
+        pbr->minRange = f.nearLimit / 3;
+        pbr->maxRange = f.farLimit / 3;
+    }
+    pbr->iterations = iterations;
+    LIBBALLISTICS_STAT(stats.iterations = iterations);
+    libballistics_statsPhase(context, &stats, PhaseZero);
+    libballistics_statsEnd(context, &stats);
+    return result;
+}
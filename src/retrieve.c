@@ -17,12 +17,12 @@
 
 */
 
-#include "ballistics.h"
+#include "internal.h"
 
 /* Retrieval functions */
 
 double libballistics_getRange (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->range;
     } 
@@ -30,7 +30,7 @@ double libballistics_getRange (ballistics_ctx_t context, int range) {
 }
 
 double libballistics_getPathY (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->pathY;
     }
@@ -38,7 +38,7 @@ double libballistics_getPathY (ballistics_ctx_t context, int range) {
 }
 
 double libballistics_getPathX (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->pathX;
     }
@@ -46,7 +46,7 @@ double libballistics_getPathX (ballistics_ctx_t context, int range) {
 }
 
 double libballistics_getElevation (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->elevation;
     }
@@ -55,7 +55,7 @@ double libballistics_getElevation (ballistics_ctx_t context, int range) {
 
 
 double libballistics_getWindage (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->windage;
     }
@@ -64,7 +64,7 @@ double libballistics_getWindage (ballistics_ctx_t context, int range) {
 
 
 double libballistics_getTime (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->time;
     }
@@ -72,7 +72,7 @@ double libballistics_getTime (ballistics_ctx_t context, int range) {
 }
 
 double libballistics_getVelocity (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->velocity;
     }
@@ -81,7 +81,7 @@ double libballistics_getVelocity (ballistics_ctx_t context, int range) {
 
 
 double libballistics_getVelocityY (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->velocityY;
     }
@@ -90,13 +90,146 @@ double libballistics_getVelocityY (ballistics_ctx_t context, int range) {
 
 
 double libballistics_getVelocityX (ballistics_ctx_t context, int range) {
-    if (range <= context->maxValidRange) {
+    if (range <= context->maxValidRange && context->trajectory) {
         trajectory_path_t traj = context->trajectory + range;
         return traj->velocityX;
     }
     return 0;
 }
 
+/* Number of valid rows in the table, from the count stored after it */
+
+unsigned long libballistics_tableRows(ballistics_ctx_t context) {
+    if (context->trajectory == NULL || context->maxRange == 0)
+        return 0;
+    return (unsigned long) context->trajectory[context->maxRange].range;
+}
+
+static double columnValue(const struct trajectory_path *row, int column) {
+    switch (column) {
+        case ColumnRange:     return row->range;
+        case ColumnPathY:     return row->pathY;
+        case ColumnPathX:     return row->pathX;
+        case ColumnElevation: return row->elevation;
+        case ColumnWindage:   return row->windage;
+        case ColumnTime:      return row->time;
+        case ColumnVelocity:  return row->velocity;
+        case ColumnVelocityX: return row->velocityX;
+        default:              return row->velocityY;
+    }
+}
+
+int libballistics_getColumn(
+    ballistics_ctx_t context,
+    int column,
+    unsigned long first,
+    unsigned long step,
+    unsigned long count,
+    double *values)
+{
+    unsigned long rows = libballistics_tableRows(context);
+    unsigned long i, range;
+
+    if (column < 0 || column >= ColumnCount)
+        return -1;
+    if (step == 0)
+        step = 1;
+
+    for (i = 0, range = first; i < count && range < rows; i++, range += step) {
+        values[i] = columnValue(context->trajectory + range, column);
+    }
+    return (int) i;
+}
+
+int libballistics_getOutput(
+    ballistics_ctx_t context,
+    ballistics_output_t output)
+{
+    unsigned long rows = libballistics_tableRows(context);
+    unsigned long n;
+
+    if (libballistics_outputBegin(output, context->maxRange))
+        return -1;
+    for (n = 0; n < rows; n++) {
+        if (libballistics_outputRow(output, context->trajectory + n, n))
+            break;
+    }
+    return (int) output->samples;
+}
+
+/* First row in [lo, hi) whose column, times 'sign', is at least 'target',
+ * or hi. The column times sign must rise over the rows. */
+
+static unsigned long searchRows(const struct trajectory_path *table,
+    int column, double sign, unsigned long lo, unsigned long hi,
+    double target)
+{
+    unsigned long mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (sign * columnValue(table + mid, column) < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+double libballistics_getRangeAt(
+    ballistics_ctx_t context,
+    int column,
+    double value)
+{
+    const struct trajectory_path *table = context->trajectory;
+    unsigned long rows = libballistics_tableRows(context);
+    unsigned long first = 0, n;
+    double sign, a, b;
+
+    switch (column) {
+        case ColumnTime:      sign = 1; break;
+        case ColumnVelocity:  sign = -1; break;
+        case ColumnPathY:     sign = -1; break;
+        default:              return -1;
+    }
+    if (rows == 0)
+        return -1;
+
+    /* The path only falls from the apex on, where vy turns negative */
+    if (column == ColumnPathY)
+        first = searchRows(table, ColumnVelocityY, -1, 0, rows, 0);
+    if (first == rows)
+        return -1;
+
+    n = searchRows(table, column, sign, first, rows, sign * value);
+    if (n == rows)
+        return -1;
+    if (n == 0)
+        return columnValue(table, column) == value ? table[0].range : -1;
+
+    /* Rows n - 1 and n bracket the value, except for a path height
+     * between the first falling row and the apex before it */
+    a = columnValue(table + n - 1, column);
+    b = columnValue(table + n, column);
+    if (sign * a >= sign * value)
+        return sign * a == sign * value ? table[n - 1].range : table[n].range;
+    if (a == b)
+        return table[n].range;
+    return table[n - 1].range
+        + (value - a) / (b - a) * (table[n].range - table[n - 1].range);
+}
+
+double libballistics_getRangeAtEnergy(
+    ballistics_ctx_t context,
+    double energy,
+    double bulletWeight)
+{
+    if (!(energy >= 0) || !(bulletWeight > 0))
+        return -1;
+    return libballistics_getRangeAt(context, ColumnVelocity,
+        sqrt(energy * 2 * -LIBBALLISTICS_GRAVITY * 7000 / bulletWeight));
+}
+
 double libballistics_computeEnergy (double velocity, double bulletWeight) {
     return bulletWeight * (velocity * velocity) / ( 2 *-LIBBALLISTICS_GRAVITY * 7000);
 }
@@ -0,0 +1,354 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Compiled drag schedules.
+ *
+ * A context's ballistic coefficients are piecewise constant in velocity,
+ * and so is the choice of drag function segment. Before a solve the two
+ * are merged into one table of velocity intervals, each carrying its
+ * segment's coefficient already divided by the interval's ballistic
+ * coefficient, so a step costs a cursor check and a pow() instead of a
+ * walk of the coefficient list. Drag curves are merged the same way, one
+ * interval per spline piece, and cost a cubic instead of the pow().
+ *
+ * Band limits are speeds over the ground while the drag function sees the
+ * speed through the air, so band breakpoints are shifted by the headwind.
+ * Between breakpoints the coefficient is the one
+ * libballistics_getBallisticCoefficient picks there; at a breakpoint
+ * itself the interval below applies, which for stepped coefficients is
+ * the band that starts at that velocity. Intervals no band covers keep
+ * the solver's rule of carrying on with the last coefficient used.
+ *
+ * With an atmosphere table the cursor scales the airspeed to the Mach
+ * number the drag function expects and the retardation by the local air
+ * density, both taken from the table at the last height it was given.
+ * Bands are published against true velocity, so the cursor then keeps a
+ * second position in the table for the band at the unscaled airspeed. */
+
+#include "internal.h"
+
+/* Breakpoints (two per coefficient) handled without allocating */
+#define SCHEDULE_BANDS  16
+
+/* Sorts 'count' velocities into ascending order and removes duplicates.
+ * Coefficient lists are short, so insertion sort is plenty. */
+
+static int sortBreakpoints(double *v, int count) {
+    int i, j, n = 0;
+    double x;
+
+    for (i = 1; i < count; i++) {
+        x = v[i];
+        for (j = i; j > 0 && v[j - 1] > x; j--)
+            v[j] = v[j - 1];
+        v[j] = x;
+    }
+    for (i = 0; i < count; i++) {
+        if (n == 0 || v[i] != v[n - 1])
+            v[n++] = v[i];
+    }
+    return n;
+}
+
+int libballistics_compileSchedule(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double headwind)
+{
+    const struct retardation_segment *segments;
+    const struct drag_curve *curve;
+    struct schedule_entry *entry;
+    ballistic_coefficient_t cur;
+    double scratch[2 * SCHEDULE_BANDS + 1];
+    double *breakpoints, *bands, lowest, threshold, probe, segmentVelocity;
+    int segmentCount, bandCount = 0, count = 0, rows, s, b;
+
+    segments = libballistics_retardationSegments(dragFunction,
+        &segmentCount);
+    curve = libballistics_dragCurve(dragFunction);
+    if (curve)
+        segmentCount = curve->count;
+    for (cur = context->bCs; cur; cur = cur->next)
+        bandCount += 2;
+
+    /* Every drag threshold and band breakpoint can start an interval */
+    rows = segmentCount + bandCount;
+    if ((unsigned long) rows > context->scheduleCapacity) {
+        entry = realloc(context->schedule,
+            rows * sizeof(struct schedule_entry));
+        if (entry == NULL)
+            return -1;
+        context->schedule = entry;
+        context->scheduleCapacity = rows;
+    }
+    breakpoints = scratch;
+    if (bandCount > SCHEDULE_BANDS) {
+        breakpoints = malloc((2 * bandCount + 1) * sizeof(double));
+        if (breakpoints == NULL)
+            return -1;
+    }
+    bands = breakpoints + bandCount;
+
+    bandCount = 0;
+    for (cur = context->bCs; cur; cur = cur->next) {
+        if (cur->minFPS > 0)
+            breakpoints[bandCount++] = cur->minFPS;
+        if (cur->maxFPS > 0)
+            breakpoints[bandCount++] = cur->maxFPS;
+    }
+    bandCount = sortBreakpoints(breakpoints, bandCount);
+
+    /* bands[b] is the coefficient between breakpoints b - 1 and b, found
+     * by asking libballistics_getBallisticCoefficient inside the interval;
+     * bands[bandCount] is the one above the last breakpoint */
+    for (b = 0; b <= bandCount; b++) {
+        if (bandCount == 0)
+            probe = 1.0;
+        else if (b == 0)
+            probe = breakpoints[0] / 2;
+        else if (b == bandCount)
+            probe = breakpoints[b - 1] * 2;
+        else
+            probe = (breakpoints[b - 1] + breakpoints[b]) / 2;
+        bands[b] = libballistics_getBallisticCoefficient(context, probe);
+    }
+    for (b = 0; b < bandCount; b++)
+        breakpoints[b] += headwind;
+
+    /* Merge the two threshold lists from the top down. Entry thresholds
+     * stop at the drag function's lowest one; below it there is no
+     * retardation to schedule. */
+    s = 0;
+    b = bandCount - 1;
+    while (s < segmentCount) {
+        segmentVelocity = curve ? curve->segments[s].velocity
+            : segments[s].velocity;
+        threshold = segmentVelocity;
+        if (b >= 0 && breakpoints[b] > threshold)
+            threshold = breakpoints[b];
+
+        entry = context->schedule + count++;
+        entry->velocity = threshold;
+        entry->bC = bands[b + 1];
+        if (curve) {
+            entry->A = LIBBALLISTICS_CURVE_K;
+            entry->M = 2;
+            entry->curve = curve->segments + s;
+        } else {
+            entry->A = segments[s].A;
+            entry->M = segments[s].M;
+            entry->curve = NULL;
+        }
+        if (entry->bC != 0.0)
+            entry->A /= entry->bC;
+
+        if (threshold == segmentVelocity)
+            s++;
+        if (b >= 0 && threshold == breakpoints[b])
+            b--;
+    }
+    if (breakpoints != scratch)
+        free(breakpoints);
+
+    lowest = libballistics_getBallisticCoefficientForLowestVelocity(context);
+    context->scheduleCount = count;
+    context->scheduleLowest = lowest;
+    return 0;
+}
+
+void libballistics_initSchedule(
+    struct schedule_cursor *cursor,
+    ballistics_ctx_t context,
+    int dragFunction,
+    double headwind)
+{
+    cursor->context = context;
+    cursor->entries = context->schedule;
+    cursor->count = context->scheduleCount;
+    cursor->index = 0;
+    cursor->band = 0;
+    cursor->headwind = headwind;
+    cursor->lastBc = 0.0;
+    cursor->switches = 0;
+    cursor->air = NULL;
+    cursor->density = 1.0;
+    cursor->sound = 1.0;
+    libballistics_initRetardationCursor(&cursor->drag, dragFunction);
+}
+
+void libballistics_scheduleAltitude(
+    struct schedule_cursor *cursor,
+    double x,
+    double y)
+{
+    const struct atmosphere_table *air = cursor->air;
+    const double *a, *b;
+    double h, f;
+    int i;
+
+    h = (x * air->sinLos + y * air->cosLos - air->base) * air->scale;
+    if (!(h > 0.0))
+        h = 0.0;
+    else if (h > ATMOSPHERE_ROWS - 1)
+        h = ATMOSPHERE_ROWS - 1;
+    i = (int) h;
+    if (i == ATMOSPHERE_ROWS - 1)
+        i--;
+    f = h - i;
+    a = air->rows[i];
+    b = air->rows[i + 1];
+    cursor->density = a[0] + f * (b[0] - a[0]);
+    cursor->sound = a[1] + f * (b[1] - a[1]);
+}
+
+/* An entry's retardation before any division by the coefficient */
+
+static double entryRetardation(const struct schedule_entry *entry, double vp)
+{
+    if (entry->curve)
+        return entry->A * libballistics_curveCd(entry->curve, vp) * vp * vp;
+    return entry->A * pow(vp, entry->M);
+}
+
+/* Entry of the schedule for airspeed 'vp', walking from entry 'i' */
+
+static int scheduleFind(const struct schedule_cursor *cursor, int i,
+    double vp)
+{
+    const struct schedule_entry *entries = cursor->entries;
+
+    while (i > 0 && vp > entries[i - 1].velocity)
+        i--;
+    while (i < cursor->count && !(vp > entries[i].velocity))
+        i++;
+    return i;
+}
+
+/* Settles the coefficient 'b' of the band in effect (zero where no band
+ * applies) into *bC, as the solvers carry coefficients on. Returns 0 if
+ * there is none. */
+
+static double scheduleCoefficient(struct schedule_cursor *cursor, double b,
+    double *bC)
+{
+    if (b == 0.0) {
+        b = cursor->lastBc;
+        if (b == 0.0)
+            b = cursor->context->scheduleLowest;
+    } else {
+        LIBBALLISTICS_STAT(cursor->switches += cursor->lastBc != 0.0
+            && b != cursor->lastBc);
+        cursor->lastBc = b;
+    }
+    *bC = b;
+    return b;
+}
+
+/* With an atmosphere table the drag function is evaluated at the airspeed
+ * scaled to standard air, and the band is the one for the true airspeed,
+ * so the two may fall in different entries */
+
+static double airRetardation(
+    struct schedule_cursor *cursor,
+    double velocity,
+    double *bC)
+{
+    const struct schedule_entry *entries = cursor->entries;
+    double vp = velocity + cursor->headwind;
+    double vs = vp * cursor->sound;
+    double b, r;
+    int i, j;
+
+    i = cursor->index = scheduleFind(cursor, cursor->index, vs);
+    j = cursor->band = scheduleFind(cursor, cursor->band, vp);
+
+    if (j < cursor->count && vp > 0 && vp < LIBBALLISTICS_MAX_VELOCITY)
+        b = entries[j].bC;
+    else
+        b = libballistics_getBallisticCoefficient(cursor->context, velocity);
+    b = scheduleCoefficient(cursor, b, bC);
+    if (b == 0.0)
+        return 0.0;
+
+    if (i < cursor->count && vs > 0 && vs < LIBBALLISTICS_MAX_VELOCITY) {
+        r = entryRetardation(entries + i, vs);
+        if (entries[i].bC != 0.0)
+            r *= entries[i].bC;
+        return cursor->density * r / b;
+    }
+    return cursor->density
+        * libballistics_computeCursorRetardation(&cursor->drag, b, vs);
+}
+
+double libballistics_scheduleRetardation(
+    struct schedule_cursor *cursor,
+    double velocity,
+    double *bC)
+{
+    const struct schedule_entry *entries = cursor->entries;
+    double vp = velocity + cursor->headwind;
+    double b;
+    int i;
+
+    if (cursor->air)
+        return airRetardation(cursor, velocity, bC);
+    i = cursor->index = scheduleFind(cursor, cursor->index, vp);
+
+    if (i < cursor->count && vp > 0 && vp < LIBBALLISTICS_MAX_VELOCITY) {
+        b = entries[i].bC;
+        if (b != 0.0) {
+            scheduleCoefficient(cursor, b, bC);
+            return entryRetardation(entries + i, vp);
+        }
+        b = scheduleCoefficient(cursor, b, bC);
+        if (b == 0.0)
+            return 0.0;
+        return entryRetardation(entries + i, vp) / b;
+    }
+
+    /* Outside the drag function, as without a schedule */
+    b = libballistics_getBallisticCoefficient(cursor->context, velocity);
+    b = scheduleCoefficient(cursor, b, bC);
+    if (b == 0.0)
+        return 0.0;
+    return libballistics_computeCursorRetardation(&cursor->drag, b, vp);
+}
+
+double libballistics_scheduleExponent(
+    const struct schedule_cursor *cursor,
+    double velocity)
+{
+    const struct schedule_entry *entry = cursor->entries + cursor->index;
+    const struct curve_segment *curve;
+    double vp = (velocity + cursor->headwind) * cursor->sound, s;
+
+    if (cursor->index < cursor->count && vp > 0
+        && vp < LIBBALLISTICS_MAX_VELOCITY) {
+        if (entry->curve == NULL)
+            return entry->M;
+
+        /* d ln(Cd v^2) / d ln v, with Cd's derivative from the cubic */
+        curve = entry->curve;
+        s = vp - curve->velocity;
+        return 2 + vp * (curve->c[1] + s * (2*curve->c[2]
+            + s * 3*curve->c[3])) / libballistics_curveCd(curve, vp);
+    }
+    return 0.0;
+}
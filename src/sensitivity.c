@@ -0,0 +1,208 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Trajectory sensitivities.
+ *
+ * The flight obeys s' = f(s, p) for the state s = (x, y, vx, vy) and the
+ * parameters p. Its derivatives T = ds/dp obey the tangent equations
+ * T' = (df/ds) T + df/dp from T(0) = ds(0)/dp, which the solvers integrate
+ * next to the state with the same method and steps. Only the velocity
+ * rows of df/ds are nonzero. With u the unit velocity vector and D(v) the
+ * retardation, the acceleration is -u D + G, and its Jacobian in the
+ * velocity is -(D/v)(I - u u') - D'(v) u u'. Each drag segment is a power
+ * law, so D' = M D / v through the air.
+ *
+ * The state derivatives are at a fixed time; rows are wanted at a fixed
+ * range. Moving back along the flight by the change in x gives
+ * dt/dp = -Tx / vx and dy/dp = Ty + vy dt/dp at the row's range.
+ *
+ * The drag tables jump slightly (up to a fraction of a percent) where one
+ * segment or coefficient band gives way to the next, and the crossing time
+ * moves with the parameters. Crossing at time c with accelerations a- and
+ * a+ either side adds (a- - a+) dc/dp to the velocity tangents, where
+ * dc/dp = -(u.Tv + dh/dp) / (u.a-) from the airspeed reaching the
+ * threshold. Without it the derivatives would be those of a smooth drag
+ * curve rather than of the tables the solvers use. */
+
+#include <string.h>
+#include "internal.h"
+
+void libballistics_tangentStart(
+    struct tangent_model *model,
+    ballistics_ctx_t context,
+    const struct schedule_cursor *schedule,
+    double velocity,
+    double zeroAngle,
+    double windVelocity,
+    double windAngle,
+    double Gx,
+    double Gy,
+    double *T)
+{
+    double k = libballistics_deg2rad(1.0);
+    double zero = libballistics_deg2rad(zeroAngle);
+
+    model->velocity = velocity;
+    model->bC = context->bCs ? context->bCs->bC : 0.0;
+    model->headwind = libballistics_headWind(windVelocity, windAngle);
+    model->crosswind = libballistics_crossWind(windVelocity, windAngle);
+    model->headwindRate = libballistics_headWind(1.0, windAngle);
+    model->crosswindRate = libballistics_crossWind(1.0, windAngle);
+    model->Gx = Gx;
+    model->Gy = Gy;
+    model->k = k;
+    model->schedule = schedule;
+    model->segment = -1;
+
+    memset(T, 0, TANGENT_SIZE * sizeof(double));
+    T[4*ParameterVelocity + 2] = cos(zero);
+    T[4*ParameterVelocity + 3] = sin(zero);
+    T[4*ParameterZeroAngle + 2] = -velocity * sin(zero) * k;
+    T[4*ParameterZeroAngle + 3] = velocity * cos(zero) * k;
+}
+
+void libballistics_tangentDerivative(
+    const struct tangent_model *model,
+    const double *s,
+    double dv,
+    const double *T,
+    double *dT)
+{
+    double v = sqrt(s[2]*s[2] + s[3]*s[3]);
+    double ux = s[2] / v, uy = s[3] / v;
+    double vp = v + model->headwind;
+    double slope = vp > 0.0 ? dv / vp
+        * libballistics_scheduleExponent(model->schedule, v) : 0.0;
+    double a = dv / v, b = slope - a, du;
+    double gx, gy;
+    const double *t;
+    double *d;
+    int p;
+
+    /* Jacobian -(a I + b u u') applied to each tangent's velocity */
+    for (p = 0; p < ParameterCount; p++) {
+        t = T + 4*p;
+        d = dT + 4*p;
+        du = ux*t[2] + uy*t[3];
+        d[0] = t[2];
+        d[1] = t[3];
+        d[2] = -(a*t[2] + b*ux*du);
+        d[3] = -(a*t[3] + b*uy*du);
+    }
+
+    /* Direct dependence. Scaling every coefficient by (1 + e) divides the
+     * retardation by it; angles turn gravity; the headwind moves the speed
+     * through the air. */
+    dT[4*ParameterBC + 2] += ux * dv / model->bC;
+    dT[4*ParameterBC + 3] += uy * dv / model->bC;
+    gx = model->Gy * model->k;
+    gy = -model->Gx * model->k;
+    dT[4*ParameterZeroAngle + 2] += gx;
+    dT[4*ParameterZeroAngle + 3] += gy;
+    dT[4*ParameterLosAngle + 2] += gx;
+    dT[4*ParameterLosAngle + 3] += gy;
+    dT[4*ParameterWind + 2] -= ux * slope * model->headwindRate;
+    dT[4*ParameterWind + 3] -= uy * slope * model->headwindRate;
+}
+
+int libballistics_tangentCross(
+    struct tangent_model *model,
+    const double *s,
+    double dv,
+    double *T)
+{
+    double v = sqrt(s[2]*s[2] + s[3]*s[3]);
+    double ux = s[2] / v, uy = s[3] / v;
+    double vp = v + model->headwind;
+    double before, rate, dc, *t;
+    const struct schedule_cursor *schedule = model->schedule;
+    int segment = schedule->index + schedule->band * (schedule->count + 1);
+    int p, crossed = 0;
+
+    /* The previous segment's power law continued to this airspeed */
+    if (segment != model->segment && model->segment >= 0 && vp > 0.0
+        && model->airspeed > 0.0) {
+        before = model->dv * pow(vp / model->airspeed, model->exponent);
+        rate = -before + ux*model->Gx + uy*model->Gy;
+        if (rate != 0.0) {
+            for (p = 0; p < ParameterCount; p++) {
+                t = T + 4*p;
+                dc = -(ux*t[2] + uy*t[3]) / rate;
+                if (p == ParameterWind)
+                    dc -= model->headwindRate / rate;
+                t[2] += ux * (dv - before) * dc;
+                t[3] += uy * (dv - before) * dc;
+            }
+            crossed = 1;
+        }
+    }
+    model->segment = segment;
+    model->dv = dv;
+    model->airspeed = vp;
+    model->exponent = libballistics_scheduleExponent(model->schedule, v);
+    return crossed;
+}
+
+void libballistics_tangentRecord(
+    const struct tangent_model *model,
+    ballistics_sensitivity_t row,
+    double x,
+    double t,
+    double vx,
+    double vy,
+    const double *T)
+{
+    double dt, lag = 17.60 * (t - x / model->velocity);
+    int p;
+
+    for (p = 0; p < ParameterCount; p++) {
+        dt = -T[4*p] / vx;
+        row->time[p] = dt;
+        row->pathY[p] = (T[4*p + 1] + vy * dt) * 12;
+        row->pathX[p] = model->crosswind * 17.60 * dt;
+    }
+    row->pathX[ParameterVelocity] += model->crosswind * 17.60 * x
+        / (model->velocity * model->velocity);
+    row->pathX[ParameterWind] += model->crosswindRate * lag;
+}
+
+void libballistics_tangentStep(double *T, const double *dT, double dt) {
+    double vx, vy;
+    int p;
+
+    for (p = 0; p < 4*ParameterCount; p += 4) {
+        vx = T[p + 2];
+        vy = T[p + 3];
+        T[p + 2] += dt * dT[p + 2];
+        T[p + 3] += dt * dT[p + 3];
+        T[p] += dt * (vx + T[p + 2]) / 2;
+        T[p + 1] += dt * (vy + T[p + 3]) / 2;
+    }
+}
+
+int libballistics_setSensitivities(
+    ballistics_ctx_t context,
+    ballistics_sensitivity_t rows,
+    unsigned long count)
+{
+    context->sensitivities = rows;
+    context->sensitivityCapacity = rows ? count : 0;
+    return 0;
+}
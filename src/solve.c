@@ -17,8 +17,9 @@
 
 */
 
-#include "ballistics.h"
+#include "internal.h"
 #include <stdio.h>
+#include <string.h>
 
 /* Context Functions */
 
@@ -27,25 +28,94 @@ ballistics_ctx_t libballistics_create(void) {
     return context;
 }
 
-void libballistics_finish(ballistics_ctx_t context) {
-    ballistic_coefficient_t cur, ptr;
-	
-	if (context == NULL)
-		return;
-    free(context->trajectory);
-    ptr = context->bCs;
+static void freeCoefficients(ballistic_coefficient_t ptr) {
+    ballistic_coefficient_t cur;
+
     while(ptr) {
         cur = ptr;
         ptr = cur->next;
         free(cur);
     }
+}
+
+void libballistics_finish(ballistics_ctx_t context) {
+	if (context == NULL)
+		return;
+    if (!context->external)
+        free(context->trajectory);
+    freeCoefficients(context->bCs);
+    freeCoefficients(context->spareBCs);
+    free(context->schedule);
+    free(context->air);
+    libballistics_statsClose(context);
     free(context);
 }
 
+void libballistics_reset(ballistics_ctx_t context) {
+    ballistic_coefficient_t ptr = context->bCs;
+
+    /* Keep the coefficients for libballistics_addBallisticCoefficient to
+     * reuse */
+    if (ptr) {
+        while (ptr->next)
+            ptr = ptr->next;
+        ptr->next = context->spareBCs;
+        context->spareBCs = context->bCs;
+        context->bCs = NULL;
+    }
+    context->maxRange = 0;
+    context->maxValidRange = 0;
+}
+
+int libballistics_setTrajectoryBuffer(
+    ballistics_ctx_t context,
+    trajectory_path_t buffer,
+    unsigned long rows)
+{
+    if (!context->external)
+        free(context->trajectory);
+    context->trajectory = buffer;
+    context->capacity = buffer ? rows : 0;
+    context->external = buffer != NULL;
+    context->readonly = 0;
+    context->maxRange = 0;
+    context->maxValidRange = 0;
+    return 0;
+}
+
+int libballistics_reserveTrajectory(ballistics_ctx_t context,
+    unsigned long rows)
+{
+    trajectory_path_t trajectory;
+
+    /* A viewed card is never written; solve into a table of our own */
+    if (context->readonly) {
+        context->trajectory = NULL;
+        context->capacity = 0;
+        context->external = 0;
+        context->readonly = 0;
+    }
+    if (rows <= context->capacity)
+        return 0;
+    if (context->external)
+        return -1;
+    trajectory = realloc(context->trajectory,
+        sizeof(struct trajectory_path) * rows);
+    if (trajectory == NULL)
+        return -1;
+    context->trajectory = trajectory;
+    context->capacity = rows;
+    return 0;
+}
+
 int libballistics_addBallisticCoefficient(ballistics_ctx_t context, double bC, double minFPS, double maxFPS) {
-    ballistic_coefficient_t coefficient = calloc(1,
-        sizeof(struct ballistic_coefficient));
+    ballistic_coefficient_t coefficient = context->spareBCs;
     ballistic_coefficient_t ptr;
+
+    if (coefficient)
+        context->spareBCs = coefficient->next;
+    else
+        coefficient = calloc(1, sizeof(struct ballistic_coefficient));
     if (coefficient == NULL)
         return -1;
     coefficient->bC = bC;
@@ -65,6 +135,20 @@ int libballistics_addBallisticCoefficient(ballistics_ctx_t context, double bC, d
     return 0;
 }    
 
+int libballistics_setIntegrator(
+    ballistics_ctx_t context,
+    int integrator,
+    double tolerance)
+{
+    if (integrator != EulerIntegrator && integrator != AdaptiveIntegrator)
+        return -1;
+    if (tolerance < 0.0)
+        return -1;
+    context->integrator = integrator;
+    context->tolerance = tolerance;
+    return 0;
+}
+
 double libballistics_getBallisticCoefficient(
     ballistics_ctx_t context, 
     double velocity) 
@@ -122,9 +206,18 @@ int libballistics_computeTrajectory (
     double t = 0, v = 0, vx = 0, vx1 = 0, vy = 0, vy1 = 0;
     double dv = 0, dvx = 0, dvy = 0, x = 0, y = 0;
     double dt = 0.5 / velocity;
-    double bC, lastBc = 0.0;
+    double bC;
     trajectory_path_t traj;
-    int n = 0;
+    struct schedule_cursor schedule;
+    ballistics_output_t output = context->output;
+    ballistics_sensitivity_t sensitivity = context->sensitivities;
+    ballistics_events_t events = context->events;
+    struct event_state from, to;
+    struct tangent_model tangent;
+    double T[TANGENT_SIZE], dT[TANGENT_SIZE], s[4];
+    struct solve_stats stats;
+    unsigned long steps = 0;
+    int n = 0, stop = 0;
     
     double headwind = libballistics_headWind (windVelocity, windAngle);
     double crosswind = libballistics_crossWind (windVelocity, windAngle);
@@ -136,47 +229,82 @@ int libballistics_computeTrajectory (
     double Gx = LIBBALLISTICS_GRAVITY 
         * sin(libballistics_deg2rad((losAngle + zeroAngle)));
 
+    if (context->integrator == AdaptiveIntegrator)
+        return libballistics_computeTrajectoryAdaptive(context, dragFunction,
+            velocity, sightHeight, losAngle, zeroAngle, windVelocity,
+            windAngle, maxRange);
+
+    libballistics_statsBegin(context, &stats);
     maxRange++;
+    if (output) {
+        if (libballistics_outputBegin(output, maxRange))
+            return -1;
+    } else if (libballistics_reserveTrajectory(context, maxRange + 1)) {
+        return -1;
+    }
+    if (sensitivity && context->sensitivityCapacity < maxRange)
+        return -1;
+    if (libballistics_compileSchedule(context, dragFunction, headwind))
+        return -1;
+    if (events)
+        libballistics_eventsBegin(events);
     context->maxRange = maxRange;
-    context->trajectory = calloc(1, sizeof(struct trajectory_path) 
-        * (maxRange + 1));
+    context->maxValidRange = 0;
+    context->muzzleVelocity = velocity;
+    context->headwind = headwind;
+    context->crosswind = crosswind;
 
     vx = velocity * cos(libballistics_deg2rad(zeroAngle));
     vy = velocity * sin(libballistics_deg2rad(zeroAngle));
     y = -sightHeight/12;
+    libballistics_initSchedule(&schedule, context, dragFunction, headwind);
+    schedule.air = libballistics_atmosphereTable(context, losAngle,
+        maxRange);
+    if (sensitivity)
+        libballistics_tangentStart(&tangent, context, &schedule, velocity,
+            zeroAngle, windVelocity, windAngle, Gx, Gy, T);
+    libballistics_statsPhase(context, &stats, PhaseSetup);
 
     for (t = 0; ;t = t + dt) {
+        steps++;
         vx1 = vx, vy1 = vy;
         v = pow(pow(vx,2) + pow(vy,2), 0.5);
         dt = 0.5 / v;
 
         /* Variable BCs may be used by adding multiple BCs with differing 
          * min/max velocieis. The correct BC will be selected at each
-         * distance calculated. */
-
-        bC = libballistics_getBallisticCoefficient(context, v);
-        if (bC == 0.0) {
-            bC = lastBc;
-            if (bC == 0.0)
-                bC = libballistics_getBallisticCoefficientForLowestVelocity(
-                    context);
-            if (bC == 0.0)
-                break;
-        } else {
-            lastBc = bC;
-        }
+         * distance calculated; the schedule has them merged with the drag
+         * function. */
 
-        /* Compute acceleration using the drag function retardation */
-        dv = libballistics_computeRetardation(dragFunction, bC, v + headwind);
+        /* Compute acceleration using the drag function retardation, in
+         * the air at the projectile's height if the atmosphere varies */
+        if (schedule.air)
+            libballistics_scheduleAltitude(&schedule, x, y);
+        dv = libballistics_scheduleRetardation(&schedule, v, &bC);
+        if (bC == 0.0)
+            break;
+        LIBBALLISTICS_STAT(stats.retardations++);
         dvx = -(vx/v) * dv;
         dvy = -(vy/v) * dv;
+        if (sensitivity) {
+            s[0] = x, s[1] = y, s[2] = vx, s[3] = vy;
+            libballistics_tangentCross(&tangent, s, dv, T);
+            libballistics_tangentDerivative(&tangent, s, dv, T, dT);
+        }
 
         /* Compute velocity, including resolved gravity vectors */
         vx = vx + dt * dvx + dt * Gx;
         vy = vy + dt * dvy + dt * Gy;
         
-        traj = context->trajectory + n;
-        if (x/3 >= n ) {
+        if (x/3 >= n && sensitivity)
+            libballistics_tangentRecord(&tangent, sensitivity + n, x, t + dt,
+                vx1, vy1, T);
+        if (x/3 >= n && output) {
+            stop = libballistics_outputState(output, n, x, y, t + dt, v,
+                vx, vy, crosswind, velocity);
+            n++;
+        } else if (x/3 >= n ) {
+            traj = context->trajectory + n;
             traj->range = x / 3;
             traj->pathY = y * 12;
             traj->pathX = libballistics_computeWindage(crosswind, 
@@ -192,19 +320,42 @@ int libballistics_computeTrajectory (
         }    
         
         /* Compute position based on average velocity */
+        from.x = x, from.y = y, from.vx = vx1, from.vy = vy1, from.t = t;
         x = x + dt * (vx+vx1) / 2;
         y = y + dt * (vy+vy1) / 2;
+        if (events) {
+            to.x = x, to.y = y, to.vx = vx, to.vy = vy, to.t = t + dt;
+            libballistics_eventsStep(events, &from, &to, NULL, NULL);
+        }
+        if (sensitivity)
+            libballistics_tangentStep(T, dT, dt);
         
         if (fabs(vy) > fabs(3*vx))
             break;
-        if (n >= maxRange)
+        if (n >= maxRange || stop)
             break;
         if (v <= 0.0 || x <= 0.0)
             break;
         context->maxValidRange = (int) x/3;
     }
+    context->steps = steps;
+    LIBBALLISTICS_STAT(stats.steps = steps);
+    LIBBALLISTICS_STAT(stats.bcLookups = stats.retardations);
+    LIBBALLISTICS_STAT(stats.bandSwitches = schedule.switches);
+    libballistics_statsPhase(context, &stats, PhaseIntegrate);
 
-    traj = context->trajectory + maxRange;
-    traj->range = n;
+    if (sensitivity)
+        memset(sensitivity + n, 0,
+            sizeof(struct ballistics_sensitivity) * (maxRange - n));
+    if (!output) {
+        /* Rows the flight did not reach read as zero, as in a fresh
+         * buffer */
+        memset(context->trajectory + n, 0,
+            sizeof(struct trajectory_path) * (maxRange + 1 - n));
+        traj = context->trajectory + maxRange;
+        traj->range = n;
+        libballistics_statsPhase(context, &stats, PhaseFinish);
+    }
+    libballistics_statsEnd(context, &stats);
     return n;
 }
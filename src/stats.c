@@ -0,0 +1,200 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Solver statistics. The solvers count into a solve_stats on the stack and
+ * only touch the context once a solve is over, so enabled counters cost an
+ * increment per step and disabled ones a branch per solve. */
+
+#include <string.h>
+#include <time.h>
+#include "internal.h"
+
+#ifdef LIBBALLISTICS_STATS
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const unsigned long long hardwareEvents[3] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+/* Opens a counter for each hardware event on the calling thread, user
+ * space only. Returns -1 (with nothing left open) if any is unavailable. */
+
+static int openHardware(ballistics_stats_t stats) {
+    struct perf_event_attr attr;
+    unsigned int i, k;
+    long fd;
+
+    for (i = 0; i < COUNTOF(hardwareEvents); i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = hardwareEvents[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            for (k = 0; k < i; k++)
+                close(stats->hardware[k]);
+            return -1;
+        }
+        stats->hardware[i] = (int) fd;
+    }
+    return 0;
+}
+
+static void closeHardware(ballistics_stats_t stats) {
+    unsigned int i;
+
+    for (i = 0; i < COUNTOF(hardwareEvents); i++)
+        close(stats->hardware[i]);
+}
+
+static void readHardware(ballistics_stats_t stats,
+    unsigned long long *values)
+{
+    unsigned int i;
+
+    for (i = 0; i < COUNTOF(hardwareEvents); i++) {
+        if (read(stats->hardware[i], values + i, sizeof(values[i]))
+            != sizeof(values[i]))
+            values[i] = 0;
+    }
+}
+
+#else
+
+static int openHardware(ballistics_stats_t stats) {
+    return -1;
+}
+
+static void closeHardware(ballistics_stats_t stats) {
+}
+
+static void readHardware(ballistics_stats_t stats,
+    unsigned long long *values)
+{
+}
+
+#endif
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void libballistics_statsBegin(ballistics_ctx_t context,
+    struct solve_stats *stats)
+{
+    int enabled = context->stats.enabled;
+
+    memset(stats, 0, sizeof(struct solve_stats));
+    if (enabled & StatsTiming)
+        stats->time = now();
+    if (enabled & StatsHardware)
+        readHardware(&context->stats, stats->hardware);
+}
+
+void libballistics_statsPhase(ballistics_ctx_t context,
+    struct solve_stats *stats, int phase)
+{
+    double t;
+
+    if (context->stats.enabled & StatsTiming) {
+        t = now();
+        context->stats.phaseTime[phase] += t - stats->time;
+        stats->time = t;
+    }
+}
+
+void libballistics_statsEnd(ballistics_ctx_t context,
+    struct solve_stats *stats)
+{
+    ballistics_stats_t total = &context->stats;
+    unsigned long long hardware[3];
+
+    if (total->enabled & StatsCounters) {
+        if (stats->zero) {
+            total->zeroSolves++;
+            total->zeroIterations += stats->iterations;
+        } else {
+            total->solves++;
+        }
+        total->steps += stats->steps;
+        total->retardations += stats->retardations;
+        total->bcLookups += stats->bcLookups;
+        total->bandSwitches += stats->bandSwitches;
+    }
+    if (total->enabled & StatsHardware) {
+        readHardware(total, hardware);
+        total->cycles += hardware[0] - stats->hardware[0];
+        total->instructions += hardware[1] - stats->hardware[1];
+        total->branchMisses += hardware[2] - stats->hardware[2];
+    }
+}
+
+void libballistics_statsClose(ballistics_ctx_t context) {
+    if (context->stats.enabled & StatsHardware)
+        closeHardware(&context->stats);
+    context->stats.enabled = 0;
+}
+
+int libballistics_setStats(ballistics_ctx_t context, int flags) {
+    int hardware = context->stats.enabled & StatsHardware;
+    int result = 0;
+
+    if (flags & ~(StatsCounters | StatsTiming | StatsHardware))
+        return -1;
+    if ((flags & StatsHardware) && !hardware) {
+        if (openHardware(&context->stats)) {
+            flags &= ~StatsHardware;
+            result = -1;
+        }
+    } else if (!(flags & StatsHardware) && hardware) {
+        closeHardware(&context->stats);
+    }
+    context->stats.enabled = flags;
+    return result;
+}
+
+#else
+
+int libballistics_setStats(ballistics_ctx_t context, int flags) {
+    context->stats.enabled = 0;
+    return flags ? -1 : 0;
+}
+
+#endif
+
+void libballistics_clearStats(ballistics_ctx_t context) {
+    struct ballistics_stats cleared;
+
+    memset(&cleared, 0, sizeof(cleared));
+    cleared.enabled = context->stats.enabled;
+    memcpy(cleared.hardware, context->stats.hardware,
+        sizeof(cleared.hardware));
+    context->stats = cleared;
+}
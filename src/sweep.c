@@ -0,0 +1,229 @@
+/*
+ GNU EXTERNAL BALLISTICS LIBRARY
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public License
+ as published by the Free Software Foundation; version 2
+ of the License.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+
+/* Parallel parameter sweeps.
+ *
+ * Grid points are sorted by estimated cost and dealt round-robin into one
+ * queue per thread, so every queue starts with its share of the expensive
+ * points. A thread takes work from the front of its own queue; once that is
+ * empty it steals from the back of another thread's queue, where the
+ * cheapest points are. Points cost a millisecond or so each, so a mutex per
+ * queue costs nothing measurable. */
+
+#include <pthread.h>
+#include <unistd.h>
+#include "internal.h"
+
+struct sweep_queue {
+    pthread_mutex_t lock;
+    unsigned long *jobs;
+    unsigned long head, tail;
+};
+
+struct sweep_worker {
+    const struct ballistics_sweep *sweep;
+    struct sweep_queue *queues;
+    int id, count;
+    pthread_t thread;
+};
+
+struct sweep_order {
+    unsigned long index;
+    double cost;
+};
+
+/* Parameters of grid point 'index' */
+
+static void sweepJob(const struct ballistics_sweep *sweep, unsigned long index,
+    struct ballistics_sweep_job *job)
+{
+    job->index = index;
+    job->maxRange = sweep->maxRange[index % sweep->maxRangeCount];
+    index /= sweep->maxRangeCount;
+    job->windAngle = sweep->windAngle[index % sweep->windAngleCount];
+    index /= sweep->windAngleCount;
+    job->windVelocity = sweep->windVelocity[index % sweep->windVelocityCount];
+    index /= sweep->windVelocityCount;
+    job->zeroAngle = sweep->zeroAngle[index % sweep->zeroAngleCount];
+    index /= sweep->zeroAngleCount;
+    job->losAngle = sweep->losAngle[index % sweep->losAngleCount];
+    index /= sweep->losAngleCount;
+    job->bC = sweep->bC[index % sweep->bCCount];
+    index /= sweep->bCCount;
+    job->velocity = sweep->velocity[index];
+}
+
+/* Estimated cost of a point. Both integrators spend their time in per-yard
+ * work: the fixed step solver takes about six steps a yard whatever the
+ * shot, and the adaptive solver's interpolated rows outweigh its steps. So
+ * the range solved is the estimate. */
+
+static double sweepCost(const struct ballistics_sweep_job *job) {
+    return (double) job->maxRange;
+}
+
+static int compareCost(const void *a, const void *b) {
+    const struct sweep_order *x = a, *y = b;
+
+    if (x->cost != y->cost)
+        return x->cost < y->cost ? 1 : -1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* Next point for worker 'id': its own queue first, then steal */
+
+static int sweepNext(struct sweep_worker *w, unsigned long *index) {
+    struct sweep_queue *q;
+    int i, found = 0;
+
+    for (i = 0; i < w->count && !found; i++) {
+        q = w->queues + (w->id + i) % w->count;
+        pthread_mutex_lock(&q->lock);
+        if (q->head < q->tail) {
+            *index = i == 0 ? q->jobs[q->head++] : q->jobs[--q->tail];
+            found = 1;
+        }
+        pthread_mutex_unlock(&q->lock);
+    }
+    return found;
+}
+
+static void *sweepWorker(void *arg) {
+    struct sweep_worker *w = arg;
+    const struct ballistics_sweep *sweep = w->sweep;
+    struct ballistics_sweep_job job;
+    ballistics_ctx_t context;
+    unsigned long index;
+    int rows;
+
+    context = libballistics_create();
+    if (context == NULL)
+        return NULL;
+    libballistics_setIntegrator(context, sweep->integrator, sweep->tolerance);
+    if (libballistics_addBallisticCoefficient(context, sweep->bC[0], 0, 0)) {
+        libballistics_finish(context);
+        return NULL;
+    }
+
+    while (sweepNext(w, &index)) {
+        sweepJob(sweep, index, &job);
+        job.worker = w->id;
+        context->bCs->bC = job.bC;
+        rows = libballistics_computeTrajectory(context, sweep->dragFunction,
+            job.velocity, sweep->sightHeight, job.losAngle, job.zeroAngle,
+            job.windVelocity, job.windAngle, job.maxRange);
+        sweep->sink(sweep->arg, &job, context, rows);
+    }
+
+    libballistics_finish(context);
+    return NULL;
+}
+
+int libballistics_computeSweep(const struct ballistics_sweep *sweep) {
+    struct sweep_order *order;
+    struct sweep_queue *queues;
+    struct sweep_worker *workers;
+    struct ballistics_sweep_job job;
+    unsigned long total, i, *jobs;
+    long online;
+    int threads, t, started, result;
+
+    if (sweep == NULL || sweep->sink == NULL)
+        return -1;
+    if (!sweep->velocity || !sweep->bC || !sweep->losAngle
+        || !sweep->zeroAngle || !sweep->windVelocity || !sweep->windAngle
+        || !sweep->maxRange)
+        return -1;
+    total = sweep->velocityCount * sweep->bCCount * sweep->losAngleCount
+        * sweep->zeroAngleCount * sweep->windVelocityCount
+        * sweep->windAngleCount * sweep->maxRangeCount;
+    if (total == 0)
+        return 0;
+
+    threads = sweep->threads;
+    if (threads <= 0) {
+        online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int) online : 1;
+    }
+    if ((unsigned long) threads > total)
+        threads = (int) total;
+
+    order = calloc(total, sizeof(struct sweep_order));
+    jobs = calloc(total, sizeof(unsigned long));
+    queues = calloc(threads, sizeof(struct sweep_queue));
+    workers = calloc(threads, sizeof(struct sweep_worker));
+    if (!order || !jobs || !queues || !workers) {
+        free(order);
+        free(jobs);
+        free(queues);
+        free(workers);
+        return -1;
+    }
+
+    for (i = 0; i < total; i++) {
+        sweepJob(sweep, i, &job);
+        order[i].index = i;
+        order[i].cost = sweepCost(&job);
+    }
+    qsort(order, total, sizeof(struct sweep_order), compareCost);
+
+    /* Queue t holds points t, t + threads, t + 2 * threads, ... of the
+     * sorted order, in a contiguous slice of 'jobs' */
+    for (t = 0, i = 0; t < threads; t++) {
+        unsigned long k;
+
+        pthread_mutex_init(&queues[t].lock, NULL);
+        queues[t].jobs = jobs + i;
+        queues[t].head = 0;
+        for (k = t; k < total; k += threads)
+            jobs[i++] = order[k].index;
+        queues[t].tail = jobs + i - queues[t].jobs;
+
+        workers[t].sweep = sweep;
+        workers[t].queues = queues;
+        workers[t].id = t;
+        workers[t].count = threads;
+    }
+    free(order);
+
+    /* The calling thread is worker 0. Workers that fail to start simply
+     * leave their queues to be stolen. */
+    started = 1;
+    for (t = 1; t < threads; t++) {
+        if (pthread_create(&workers[t].thread, NULL, sweepWorker,
+            workers + t) != 0)
+            break;
+        started++;
+    }
+    sweepWorker(workers);
+    for (t = 1; t < started; t++)
+        pthread_join(workers[t].thread, NULL);
+
+    /* Points are only left over if no worker could allocate a context */
+    for (t = 0, result = 0; t < threads; t++) {
+        if (queues[t].head < queues[t].tail)
+            result = -1;
+        pthread_mutex_destroy(&queues[t].lock);
+    }
+    free(jobs);
+    free(queues);
+    free(workers);
+    return result;
+}
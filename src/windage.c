@@ -17,7 +17,8 @@
 
 */
 
-#include "ballistics.h"
+#include <string.h>
+#include "internal.h"
 
 /* Windage Calculations */
 
@@ -42,3 +43,93 @@ double libballistics_crossWind (double windSpeed, double windAngle) {
 }
 
 
+
+/* Headwinds closer than this (MPH) to the solution's count as the same */
+#define HEADWIND_TOLERANCE  1e-6
+
+/* Rows hold range in yards; the solvers compute windage from feet */
+
+static double rowPathX(const struct trajectory_path *row, double crosswind,
+    double velocity)
+{
+    return libballistics_computeWindage(crosswind, velocity, row->range * 3,
+        row->time);
+}
+
+int libballistics_computeWindSweep(
+    ballistics_ctx_t context,
+    const double *windVelocity,
+    const double *windAngle,
+    int count,
+    unsigned long stride,
+    double *pathX,
+    double *windage,
+    int *flags)
+{
+    const struct trajectory_path *row;
+    unsigned long rows = libballistics_tableRows(context), r;
+    double crosswind, x;
+    int i;
+
+    if (context->trajectory == NULL)
+        return -1;
+    if (rows > stride)
+        rows = stride;
+
+    for (i = 0; i < count; i++) {
+        crosswind = libballistics_crossWind(windVelocity[i], windAngle[i]);
+        if (flags)
+            flags[i] = fabs(libballistics_headWind(windVelocity[i],
+                windAngle[i]) - context->headwind) > HEADWIND_TOLERANCE;
+        for (r = 0, row = context->trajectory; r < rows; r++, row++) {
+            x = rowPathX(row, crosswind, context->muzzleVelocity);
+            if (pathX)
+                pathX[i * stride + r] = x;
+            if (windage)
+                windage[i * stride + r] = x * 95.5 / row->range;
+        }
+    }
+    return (int) rows;
+}
+
+/* Replaces a viewed card's table with a copy the context owns, so the
+ * rows can be rewritten without touching the card */
+
+static int ownTable(ballistics_ctx_t context) {
+    trajectory_path_t table = malloc(sizeof(struct trajectory_path)
+        * context->capacity);
+
+    if (table == NULL)
+        return -1;
+    memcpy(table, context->trajectory,
+        sizeof(struct trajectory_path) * context->capacity);
+    context->trajectory = table;
+    context->external = 0;
+    context->readonly = 0;
+    return 0;
+}
+
+int libballistics_setWind(
+    ballistics_ctx_t context,
+    double windVelocity,
+    double windAngle)
+{
+    struct trajectory_path *row;
+    unsigned long rows = libballistics_tableRows(context), r;
+    double crosswind = libballistics_crossWind(windVelocity, windAngle);
+
+    if (context->trajectory == NULL)
+        return -1;
+    if (fabs(libballistics_headWind(windVelocity, windAngle)
+        - context->headwind) > HEADWIND_TOLERANCE)
+        return 1;
+    if (context->readonly && ownTable(context))
+        return -1;
+
+    for (r = 0, row = context->trajectory; r < rows; r++, row++) {
+        row->pathX = rowPathX(row, crosswind, context->muzzleVelocity);
+        row->windage = row->pathX * 95.5 / row->range;
+    }
+    context->crosswind = crosswind;
+    return 0;
+}
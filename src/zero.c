@@ -17,12 +17,19 @@
 
 */
 
-#include "ballistics.h"
+#include "internal.h"
+#include "drag_models.h"
 
 /* Zero Calculations */
 
-double libballistics_computeZeroAngle(
-    int dragFunction, 
+/* libballistics_computeZeroAngle for one drag model's segment table, or a
+ * drag curve. It is instantiated per model below, so each instance steps
+ * with the table's thresholds and coefficients as constants. */
+
+DRAG_MODEL_INLINE double zeroAngle(
+    const struct retardation_segment *segments,
+    int count,
+    const struct drag_curve *curve,
     double bC, 
     double velocity, 
     double sightHeight, 
@@ -40,6 +47,7 @@ double libballistics_computeZeroAngle(
     double dv=0, dvx=0, dvy=0; /* Acceleration */
     double Gx=0, Gy=0;         /* Gravitational acceleration */
     double angle=0;            /* Angle of the bore */
+    int segment=0;             /* Drag segment of the last step */
 
     /* Start with a coarse angular change to quickly solve
      *  large launch angle problems */
@@ -65,7 +73,10 @@ double libballistics_computeZeroAngle(
             v=pow((pow(vx,2)+pow(vy,2)),0.5);
             dt=1/v;
             
-            dv = libballistics_computeRetardation(dragFunction, bC, v);
+            if (curve)
+                dv = libballistics_curveRetardation(curve, &segment, bC, v);
+            else
+                dv = dragModelRetardation(segments, count, &segment, bC, v);
             dvy = -dv*vy/v*dt;
             dvx = -dv*vx/v*dt;
 
@@ -100,3 +111,229 @@ double libballistics_computeZeroAngle(
     return libballistics_rad2deg(angle);
 }
 
+
+#define ZERO_MODEL(model) \
+    static double zeroAngle##model(double bC, double velocity, \
+        double sightHeight, double zeroRange, double yIntercept) \
+    { \
+        return zeroAngle(model##Segments, COUNTOF(model##Segments), NULL, \
+            bC, velocity, sightHeight, zeroRange, yIntercept); \
+    }
+
+LIBBALLISTICS_DRAG_MODELS(ZERO_MODEL)
+
+#define ZERO_DISPATCH(model) \
+    case model: \
+        return zeroAngle##model(bC, velocity, sightHeight, zeroRange, \
+            yIntercept);
+
+double libballistics_computeZeroAngle(
+    int dragFunction, 
+    double bC, 
+    double velocity, 
+    double sightHeight, 
+    double zeroRange, 
+    double yIntercept)
+{
+    switch (dragFunction) {
+        LIBBALLISTICS_DRAG_MODELS(ZERO_DISPATCH)
+        default:
+            return zeroAngle(NULL, 0, libballistics_dragCurve(dragFunction),
+                bC, velocity, sightHeight, zeroRange, yIntercept);
+    }
+}
+
+#undef ZERO_MODEL
+#undef ZERO_DISPATCH
+
+
+/* Height (feet) at which a flight launched at 'angle' radians crosses
+ * 'range' feet, integrated as in libballistics_computeZeroAngle but stopping
+ * at the range. The last step is interpolated to land exactly on it. The
+ * ballistic coefficient is 'bC', or looked up in 'context' at each step
+ * when one is given. Returns -1 if the projectile never gets there. */
+
+static int zeroFlight(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double bC,
+    double velocity,
+    double sightHeight,
+    double range,
+    double angle,
+    double *height,
+    struct solve_stats *stats)
+{
+    struct retardation_cursor cursor;
+    struct schedule_cursor schedule;
+    double x = 0, y = -sightHeight/12, x1, y1;
+    double vx = velocity*cos(angle), vy = velocity*sin(angle);
+    double vx1, vy1, v, dt, dv;
+    double Gx = LIBBALLISTICS_GRAVITY*sin(angle);
+    double Gy = LIBBALLISTICS_GRAVITY*cos(angle);
+
+    if (context)
+        libballistics_initSchedule(&schedule, context, dragFunction, 0);
+    else
+        libballistics_initRetardationCursor(&cursor, dragFunction);
+
+    while (x < range) {
+        vx1 = vx;
+        vy1 = vy;
+        v = sqrt(vx*vx + vy*vy);
+        if (v <= 0.0)
+            return -1;
+        dt = 1/v;
+        LIBBALLISTICS_STAT(stats->steps++);
+
+        if (context) {
+            dv = libballistics_scheduleRetardation(&schedule, v, &bC);
+            if (bC == 0.0)
+                return -1;
+            LIBBALLISTICS_STAT(stats->bcLookups++);
+            LIBBALLISTICS_STAT(stats->bandSwitches += schedule.switches);
+            LIBBALLISTICS_STAT(schedule.switches = 0);
+        } else {
+            dv = libballistics_computeCursorRetardation(&cursor, bC, v);
+        }
+        LIBBALLISTICS_STAT(stats->retardations++);
+        vx = vx - dv*vx/v*dt + dt*Gx;
+        vy = vy - dv*vy/v*dt + dt*Gy;
+
+        x1 = x + dt*(vx+vx1)/2;
+        y1 = y + dt*(vy+vy1)/2;
+        if (x1 >= range) {
+            *height = y + (y1 - y) * (range - x) / (x1 - x);
+            return 0;
+        }
+        x = x1;
+        y = y1;
+
+        if (vx <= 0.0 || vy > 3*vx)
+            return -1;
+    }
+
+    *height = y;
+    return 0;
+}
+
+/* Residuals below this (inches) count as converged */
+#define ZERO_TOLERANCE      1e-4
+#define ZERO_MAX_ITERATIONS 20
+
+/* libballistics_solveZeroAngle, with the ballistic coefficient taken from
+ * 'context' when one is given */
+
+static int solveZero(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double bC,
+    double velocity,
+    double sightHeight,
+    double zeroRange,
+    double yIntercept,
+    zero_solution_t solution,
+    struct solve_stats *stats)
+{
+    double range = zeroRange*3;
+    double target = yIntercept/12;
+    double t, angle0, angle1, angle, r0, r1, y;
+    int iterations = 0;
+
+    solution->angle = 0;
+    solution->iterations = 0;
+    solution->residual = 0;
+    if (!(range > 0) || !(velocity > 0) || !(bC > 0))
+        return -1;
+
+    /* Flat fire estimate: drop in a vacuum over the time of flight at
+     * muzzle velocity. Drag makes the real drop larger, so this is a little
+     * low, but close enough for the updates below. */
+    t = range/velocity;
+    angle0 = atan((target + sightHeight/12
+        - 0.5*LIBBALLISTICS_GRAVITY*t*t) / range);
+
+    iterations++;
+    LIBBALLISTICS_STAT(stats->iterations = iterations);
+    solution->angle = libballistics_rad2deg(angle0);
+    solution->iterations = iterations;
+    if (zeroFlight(context, dragFunction, bC, velocity, sightHeight, range,
+        angle0, &y, stats))
+        return -1;
+    r0 = y - target;
+
+    /* Raising the bore by a small angle swings the whole trajectory about
+     * the muzzle, which moves the impact by about range * angle. That is
+     * the Newton step for the first update; the secant through the last
+     * two flights takes over from there. */
+    angle1 = angle0 - r0/range;
+    for (;;) {
+        iterations++;
+        LIBBALLISTICS_STAT(stats->iterations = iterations);
+        if (zeroFlight(context, dragFunction, bC, velocity, sightHeight,
+            range, angle1, &y, stats))
+            return -1;
+        r1 = y - target;
+
+        solution->angle = libballistics_rad2deg(angle1);
+        solution->iterations = iterations;
+        solution->residual = r1*12;
+
+        /* Two trials with the same residual stall the secant; that is
+         * only a solution if the residual is within tolerance */
+        if (fabs(r1*12) < ZERO_TOLERANCE)
+            break;
+        if (r1 == r0)
+            return -1;
+        if (iterations >= ZERO_MAX_ITERATIONS)
+            return -1;
+
+        angle = angle1 - r1*(angle1 - angle0)/(r1 - r0);
+        angle0 = angle1;
+        r0 = r1;
+        angle1 = angle;
+    }
+
+    return 0;
+}
+
+int libballistics_solveZeroAngle(
+    int dragFunction,
+    double bC,
+    double velocity,
+    double sightHeight,
+    double zeroRange,
+    double yIntercept,
+    zero_solution_t solution)
+{
+    struct solve_stats stats = {0};
+
+    return solveZero(NULL, dragFunction, bC, velocity, sightHeight,
+        zeroRange, yIntercept, solution, &stats);
+}
+
+int libballistics_solveContextZero(
+    ballistics_ctx_t context,
+    int dragFunction,
+    double velocity,
+    double sightHeight,
+    double zeroRange,
+    double yIntercept,
+    zero_solution_t solution)
+{
+    struct solve_stats stats;
+    double bC = 0.0;
+    int result;
+
+    if (context->bCs)
+        bC = context->bCs->bC;
+    libballistics_statsBegin(context, &stats);
+    LIBBALLISTICS_STAT(stats.zero = 1);
+    if (libballistics_compileSchedule(context, dragFunction, 0))
+        return -1;
+    result = solveZero(context, dragFunction, bC, velocity, sightHeight,
+        zeroRange, yIntercept, solution, &stats);
+    libballistics_statsPhase(context, &stats, PhaseZero);
+    libballistics_statsEnd(context, &stats);
+    return result;
+}